@@ -0,0 +1,101 @@
+/*
+Sub-frame integration of gamepad axes
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "AxisIntegrator.h"
+
+#include <algorithm>
+#include <math.h>
+#include <time.h>
+
+// ----------------------------------------------------------------------------
+AxisIntegrator::AxisIntegrator() : deadzone(0), exponent(1), last(-1)
+{
+}
+
+double AxisIntegrator::Filter(double value, double deadzone, double exponent)
+{
+    double magnitude = std::min(fabs(value), 1.0);
+    if (magnitude <= deadzone)
+        return 0.0;
+    magnitude = pow((magnitude - deadzone)/(1.0 - deadzone), exponent);
+    return value < 0 ? -magnitude : magnitude;
+}
+
+// ----------------------------------------------------------------------------
+void AxisIntegrator::Integrate(const std::vector<gp_axis_sample>& samples, const std::vector<signed short>& current, double now)
+{
+    size_t n = current.size();
+    this->mean.assign(n, 0.0);
+
+    if (this->last < 0 || now <= this->last || this->held.size() != n)
+    {
+        for (size_t i = 0; i < n; i++)
+            this->mean[i] = Filter(current[i]/32767.0, this->deadzone, this->exponent);
+    }
+    else
+    {
+        // Axes without samples take the current value for the whole interval
+        std::vector<double> t(n, this->last);
+        std::vector<bool> sampled(n, false);
+        for (size_t s = 0; s < samples.size(); s++)
+        {
+            int i = samples[s].number;
+            if (i >= (int)n)
+                continue;
+            // Samples that arrive late still count from the start of the interval
+            double ts = std::min(std::max(samples[s].time, this->last), now);
+            this->mean[i] += Filter(this->held[i]/32767.0, this->deadzone, this->exponent)*(ts - t[i]);
+            t[i] = ts;
+            this->held[i] = samples[s].value;
+            sampled[i] = true;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            signed short value = sampled[i] ? this->held[i] : current[i];
+            this->mean[i] += Filter(value/32767.0, this->deadzone, this->exponent)*(now - t[i]);
+            this->mean[i] /= now - this->last;
+        }
+    }
+
+    this->held = current;
+    this->last = now;
+}
+
+void AxisIntegrator::Update(GamepadSource* source)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    source->getAxisSamples(this->samples);
+    this->Integrate(this->samples, source->getGamepadState()->axis, ts.tv_sec + ts.tv_nsec/1e9);
+}
@@ -0,0 +1,82 @@
+#ifndef __AXISINTEGRATOR_H__
+#define __AXISINTEGRATOR_H__
+
+/*
+Sub-frame integration of gamepad axes
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GamepadHandler.h"
+
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// Description:
+// Turns the axis samples that arrived between two ticks into the mean of
+// each filtered axis over the tick: the area under the axis curve, every
+// value held until the next sample, divided by the tick length. A short
+// flick of a stick between two ticks then moves the camera as far at 10
+// frames per second as at 100. Deadzone and response curve are applied to
+// every sample before integration, not to the mean.
+class AxisIntegrator {
+public:
+    AxisIntegrator();
+
+    // Filter a normalized axis value in [-1, 1]: magnitudes within the
+    // deadzone become 0, the rest is rescaled to [0, 1] and raised to
+    // exponent, keeping the sign.
+    static double Filter(double value, double deadzone, double exponent);
+
+    // Mean of each filtered axis over (previous call, now]. current holds
+    // the axis values at now; it is used as is on the first call and for
+    // axes without samples in the interval (sources without samples, or
+    // samples lost), and resynchronizes axes whose samples were lost.
+    void Integrate(const std::vector<gp_axis_sample>& samples, const std::vector<signed short>& current, double now);
+
+    // Collect the source's samples and integrate them up to the current
+    // CLOCK_MONOTONIC time
+    void Update(GamepadSource* source);
+
+    // Filtered mean of axis i over the last interval, in [-1, 1]
+    double GetAxis(int i) const { return i < (int)this->mean.size() ? this->mean[i] : 0.0; }
+
+    double deadzone;        // fraction of the axis range
+    double exponent;        // 1 is linear, larger gives finer control near the center
+
+private:
+    double last;
+    std::vector<signed short> held;     // raw axis values at last
+    std::vector<double> mean;
+    std::vector<gp_axis_sample> samples;
+};
+
+#endif
@@ -0,0 +1,427 @@
+/*
+Camera-motion driven prefetching of out-of-core data bricks
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "BrickPrefetcher.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <iostream>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------
+// Description:
+// Frustum as six inward facing planes, n.x + d >= 0 inside
+struct frustum {
+    double n[6][3];
+    double d[6];
+};
+
+static void cross(const double* a, const double* b, double* c)
+{
+    c[0] = a[1]*b[2] - a[2]*b[1];
+    c[1] = a[2]*b[0] - a[0]*b[2];
+    c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static void normalize(double* v)
+{
+    double length = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    if (length > 0)
+        for (int k = 0; k < 3; k++)
+            v[k] /= length;
+}
+
+// Rotate v by angle (radians) around the unit vector axis
+static void rotate(const double* v, const double* axis, double angle, double* out)
+{
+    double c = cos(angle), s = sin(angle);
+    double a[3];
+    cross(axis, v, a);
+    double dot = axis[0]*v[0] + axis[1]*v[1] + axis[2]*v[2];
+    for (int k = 0; k < 3; k++)
+        out[k] = v[k]*c + a[k]*s + axis[k]*dot*(1 - c);
+}
+
+// Frustum of the camera extrapolated t seconds ahead
+static void predictFrustum(const prefetch_camera& cam, double t, double farDistance, frustum* f, double* position)
+{
+    double up[3] = { cam.viewUp[0], cam.viewUp[1], cam.viewUp[2] };
+    normalize(up);
+
+    double dir[3], right[3], trueUp[3];
+    rotate(cam.direction, up, cam.yawRate*t*M_PI/180, dir);
+    normalize(dir);
+    cross(dir, up, right);
+    normalize(right);
+    cross(right, dir, trueUp);
+
+    for (int k = 0; k < 3; k++)
+        position[k] = cam.position[k] + cam.velocity[k]*t;
+
+    double a = cam.viewAngle*M_PI/360;
+    double b = atan(tan(a)*cam.aspect);
+    for (int k = 0; k < 3; k++)
+    {
+        f->n[0][k] = dir[k];
+        f->n[1][k] = -dir[k];
+        f->n[2][k] = dir[k]*sin(b) + right[k]*cos(b);
+        f->n[3][k] = dir[k]*sin(b) - right[k]*cos(b);
+        f->n[4][k] = dir[k]*sin(a) + trueUp[k]*cos(a);
+        f->n[5][k] = dir[k]*sin(a) - trueUp[k]*cos(a);
+    }
+    for (int i = 0; i < 6; i++)
+        f->d[i] = -(f->n[i][0]*position[0] + f->n[i][1]*position[1] + f->n[i][2]*position[2]);
+    f->d[0] -= cam.clippingRange[0];
+    f->d[1] += farDistance;
+}
+
+// Conservative: false only when the box is completely outside a plane
+static bool intersects(const frustum& f, const double* bounds)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        double dist = f.d[i];
+        for (int k = 0; k < 3; k++)
+            dist += f.n[i][k]*(f.n[i][k] > 0 ? bounds[2*k+1] : bounds[2*k]);
+        if (dist < 0)
+            return false;
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+BrickPrefetcher::BrickPrefetcher(uint64_t budget, int threads)
+    : budget(budget), running(true), haveCamera(false), next(0)
+{
+    this->stats = prefetch_stats();
+    this->planner = std::thread(&BrickPrefetcher::Plan, this);
+    for (int i = 0; i < std::max(threads, 1); i++)
+        this->loaders.push_back(std::thread(&BrickPrefetcher::Load, this));
+}
+
+BrickPrefetcher::~BrickPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+    this->planWake.notify_all();
+    this->loadWake.notify_all();
+    this->planner.join();
+    for (size_t i = 0; i < this->loaders.size(); i++)
+        this->loaders[i].join();
+
+    for (std::map<std::string, mapped_file>::iterator it = this->files.begin(); it != this->files.end(); ++it)
+    {
+        munmap(const_cast<char*>(it->second.data), it->second.length);
+        close(it->second.fd);
+    }
+}
+
+// ----------------------------------------------------------------------------
+int BrickPrefetcher::AddBrick(const char* path, const double* bounds, uint64_t offset, uint64_t size)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    std::map<std::string, mapped_file>::iterator it = this->files.find(path);
+    if (it == this->files.end())
+    {
+        mapped_file file;
+        struct stat st;
+        file.fd = open(path, O_RDONLY);
+        if (file.fd < 0 || fstat(file.fd, &st) < 0 || st.st_size == 0)
+        {
+            std::cout << "WARNING: can not open brick file " << path << std::endl;
+            if (file.fd >= 0)
+                close(file.fd);
+            return -1;
+        }
+        file.length = st.st_size;
+        void* data = mmap(NULL, file.length, PROT_READ, MAP_SHARED, file.fd, 0);
+        if (data == MAP_FAILED)
+        {
+            std::cout << "WARNING: can not map brick file " << path << std::endl;
+            close(file.fd);
+            return -1;
+        }
+        file.data = static_cast<const char*>(data);
+        it = this->files.insert(std::make_pair(std::string(path), file)).first;
+    }
+
+    if (offset + size > it->second.length || size == 0)
+        return -1;
+
+    brick b;
+    std::copy(bounds, bounds + 6, b.bounds);
+    b.file = &it->second;
+    b.offset = offset;
+    b.size = size;
+    b.state = ABSENT;
+    b.accessed = false;
+    b.lru = this->lru.end();
+    this->bricks.push_back(b);
+    this->wanted.push_back(0);
+    return (int)this->bricks.size() - 1;
+}
+
+void BrickPrefetcher::Update(const prefetch_camera& camera)
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->camera = camera;
+        this->haveCamera = true;
+    }
+    this->planWake.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+const char* BrickPrefetcher::Access(int id, uint64_t* size, bool* hit)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (id < 0 || id >= (int)this->bricks.size())
+        return NULL;
+
+    brick& b = this->bricks[id];
+    if (hit != NULL)
+        *hit = b.state == RESIDENT;
+    if (b.state == RESIDENT)
+    {
+        this->stats.hits++;
+        this->lru.splice(this->lru.begin(), this->lru, b.lru);
+    }
+    else
+    {
+        this->stats.misses++;
+        // The reader faults it in now, account for it like a loaded brick
+        if (b.state == ABSENT)
+        {
+            this->MakeRoom(b.size);
+            b.state = RESIDENT;
+            this->stats.residentBytes += b.size;
+            this->lru.push_front(id);
+            b.lru = this->lru.begin();
+        }
+    }
+    b.accessed = true;
+
+    *size = b.size;
+    return b.file->data + b.offset;
+}
+
+prefetch_stats BrickPrefetcher::GetStats()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    prefetch_stats s = this->stats;
+    s.pending = 0;
+    for (size_t i = 0; i < this->queue.size(); i++)
+        if (this->bricks[this->queue[i]].state != RESIDENT)
+            s.pending++;
+    return s;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Planner thread: for every new camera, order the bricks by the first
+// predicted frustum they are in, nearer bricks first within a frustum.
+// Bricks outside all predicted frusta are not wanted.
+void BrickPrefetcher::Plan()
+{
+    std::unique_lock<std::mutex> guard(this->lock);
+    while (true)
+    {
+        this->planWake.wait(guard, [this]() { return !this->running || this->haveCamera; });
+        if (!this->running)
+            break;
+
+        prefetch_camera cam = this->camera;
+        this->haveCamera = false;
+        for (size_t i = this->planBounds.size()/6; i < this->bricks.size(); i++)
+            this->planBounds.insert(this->planBounds.end(), this->bricks[i].bounds, this->bricks[i].bounds + 6);
+        double stepLength = std::max(cam.step, 1e-3);
+        int steps = std::max((int)ceil(cam.horizon/stepLength), 0) + 1;
+        double farDistance = cam.maxDistance > 0 ? cam.maxDistance : cam.clippingRange[1];
+        guard.unlock();
+
+        std::vector<frustum> frusta(steps);
+        std::vector<double> positions(3*steps);
+        for (int s = 0; s < steps; s++)
+            predictFrustum(cam, s*stepLength, farDistance, &frusta[s], &positions[3*s]);
+
+        std::vector<std::pair<double, int> > order;
+        int n = this->planBounds.size()/6;
+        for (int i = 0; i < n; i++)
+        {
+            const double* bounds = &this->planBounds[6*i];
+            for (int s = 0; s < steps; s++)
+            {
+                if (!intersects(frusta[s], bounds))
+                    continue;
+                double d2 = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    double c = 0.5*(bounds[2*k] + bounds[2*k+1]) - positions[3*s+k];
+                    d2 += c*c;
+                }
+                // Steps dominate, distance orders within a step
+                order.push_back(std::make_pair(s + sqrt(d2)/(sqrt(d2) + farDistance), i));
+                break;
+            }
+        }
+        std::sort(order.begin(), order.end());
+
+        guard.lock();
+        std::fill(this->wanted.begin(), this->wanted.end(), 0);
+        this->queue.resize(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            this->queue[i] = order[i].second;
+            this->wanted[order[i].second] = 1;
+        }
+        this->next = 0;
+        this->loadWake.notify_all();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Loader threads: take the most urgent brick that is not resident yet.
+// Once the budget is full of bricks that are wanted the rest of the queue
+// waits for the next plan.
+void BrickPrefetcher::Load()
+{
+    long page = sysconf(_SC_PAGESIZE);
+    std::unique_lock<std::mutex> guard(this->lock);
+    while (this->running)
+    {
+        while (this->next < this->queue.size() && this->bricks[this->queue[this->next]].state != ABSENT)
+            this->next++;
+        if (this->next == this->queue.size())
+        {
+            this->loadWake.wait(guard);
+            continue;
+        }
+
+        int id = this->queue[this->next++];
+        if (!this->MakeRoom(this->bricks[id].size))
+        {
+            this->next = this->queue.size();
+            continue;
+        }
+        this->bricks[id].state = LOADING;
+        this->stats.residentBytes += this->bricks[id].size;
+
+        const char* start;
+        size_t length;
+        Range(this->bricks[id], false, &start, &length);
+        guard.unlock();
+
+        madvise(const_cast<char*>(start), length, MADV_WILLNEED);
+        volatile char sink = 0;
+        for (size_t offset = 0; offset < length; offset += page)
+            sink += start[offset];
+        (void)sink;
+
+        guard.lock();
+        brick& b = this->bricks[id];
+        b.state = RESIDENT;
+        this->lru.push_front(id);
+        b.lru = this->lru.begin();
+        this->stats.prefetched++;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Evict least recently used bricks that are not wanted until size fits
+bool BrickPrefetcher::MakeRoom(uint64_t size)
+{
+    std::list<int>::iterator it = this->lru.end();
+    while (this->stats.residentBytes + size > this->budget && it != this->lru.begin())
+    {
+        --it;
+        int id = *it;
+        if (this->wanted[id])
+            continue;
+        ++it;
+        this->Evict(id);
+    }
+    return this->stats.residentBytes + size <= this->budget;
+}
+
+void BrickPrefetcher::Evict(int id)
+{
+    brick& b = this->bricks[id];
+    const char* start;
+    size_t length;
+    Range(b, true, &start, &length);
+
+    // Drop the pages from this mapping and from the page cache, a later
+    // access reads them from the file again. Pages shared with the
+    // neighbouring bricks stay, they may be in use.
+    if (length > 0)
+    {
+        madvise(const_cast<char*>(start), length, MADV_DONTNEED);
+        posix_fadvise(b.file->fd, start - b.file->data, length, POSIX_FADV_DONTNEED);
+    }
+
+    this->lru.erase(b.lru);
+    b.lru = this->lru.end();
+    b.state = ABSENT;
+    this->stats.residentBytes -= b.size;
+    this->stats.evicted++;
+    if (!b.accessed)
+        this->stats.wasted++;
+    b.accessed = false;
+}
+
+// Page aligned range of the mapping: covering the brick, or only the
+// pages that lie wholly inside it (possibly none)
+void BrickPrefetcher::Range(const brick& b, bool whole, const char** start, size_t* length)
+{
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t end = b.offset + b.size;
+    uint64_t first = b.offset - b.offset % page;
+    if (whole)
+    {
+        if (first < b.offset)
+            first += page;
+        end -= end % page;
+        // A brick's end page is whole when the file ends there
+        if (b.offset + b.size == b.file->length)
+            end = b.offset + b.size;
+    }
+    *start = b.file->data + first;
+    *length = end > first ? end - first : 0;
+}
@@ -0,0 +1,151 @@
+#ifndef __BRICKPREFETCHER_H__
+#define __BRICKPREFETCHER_H__
+
+/*
+Camera-motion driven prefetching of out-of-core data bricks
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Camera pose plus its current motion, frusta ahead are extrapolated
+// from this. The prediction settings travel along, so they change
+// together with the camera under the prefetcher's lock.
+struct prefetch_camera {
+    double position[3];
+    double direction[3];        // view direction, unit length
+    double viewUp[3];
+    double velocity[3];         // world units per second
+    double yawRate;             // degrees per second around viewUp
+    double viewAngle;           // vertical, degrees
+    double aspect;              // width / height
+    double clippingRange[2];
+    double horizon;             // seconds to look ahead
+    double step;                // between predicted frusta
+    double maxDistance;         // far plane for prediction, 0 uses clippingRange[1]
+};
+
+struct prefetch_stats {
+    uint64_t hits;              // Access() found the brick resident
+    uint64_t misses;
+    uint64_t prefetched;        // bricks loaded ahead of use
+    uint64_t evicted;
+    uint64_t wasted;            // evicted without ever being accessed
+    uint64_t residentBytes;
+    uint64_t pending;           // predicted visible but not resident yet
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Keeps the bricks of an out-of-core dataset that the camera is about to
+// see in memory. Each brick is a byte range of a file plus its world
+// bounds. The files are mapped read-only; a planner thread intersects the
+// bricks with the frusta the camera will have over the next horizon
+// seconds and orders them by when they become visible, I/O threads then
+// fault them in (madvise and a read per page) in that order. Resident
+// bricks are kept within the memory budget by dropping the least
+// recently used ones that are not predicted visible.
+//
+// Readers get the data through Access(), which is also where hits and
+// misses are counted. Update() and Access() only take a lock briefly,
+// all I/O and frustum tests happen on the worker threads.
+class BrickPrefetcher {
+public:
+    BrickPrefetcher(uint64_t budget, int threads = 4);
+    ~BrickPrefetcher();
+
+    // Register a brick, returns its id or -1 when the file can not be
+    // mapped or the range lies outside it
+    int AddBrick(const char* path, const double* bounds, uint64_t offset, uint64_t size);
+
+    // Called once per tick with the current camera motion
+    void Update(const prefetch_camera& camera);
+
+    // The brick's data, NULL for an unknown id. A brick that was not
+    // resident is read on demand by the kernel and counts as a miss; hit
+    // (may be NULL) tells which of the two this access was.
+    const char* Access(int id, uint64_t* size, bool* hit = NULL);
+
+    prefetch_stats GetStats();
+
+private:
+    enum brick_state { ABSENT, LOADING, RESIDENT };
+
+    struct mapped_file {
+        int fd;
+        const char* data;
+        uint64_t length;
+    };
+
+    struct brick {
+        double bounds[6];
+        const mapped_file* file;
+        uint64_t offset, size;
+        brick_state state;
+        bool accessed;
+        std::list<int>::iterator lru;
+    };
+
+    void Plan();
+    void Load();
+    bool MakeRoom(uint64_t size);
+    void Evict(int id);
+    static void Range(const brick& b, bool whole, const char** start, size_t* length);
+
+    std::vector<brick> bricks;
+    std::map<std::string, mapped_file> files;
+    uint64_t budget;
+
+    std::mutex lock;
+    std::condition_variable planWake, loadWake;
+    bool running;
+    bool haveCamera;
+    prefetch_camera camera;
+    std::vector<int> queue;         // predicted visible, soonest first
+    std::vector<char> wanted;       // per brick, in queue
+    size_t next;                    // first queue entry not handed out yet
+    std::list<int> lru;             // resident bricks, most recently used first
+    prefetch_stats stats;
+
+    std::thread planner;
+    std::vector<std::thread> loaders;
+    std::vector<double> planBounds;  // planner's copy of the brick bounds
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+Lock-free queue of camera commands from other threads
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "CameraCommandQueue.h"
+
+// ----------------------------------------------------------------------------
+CameraCommandQueue::CameraCommandQueue(size_t capacity) : tail(0), head(0)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    this->slots.reset(new slot[size]);
+    this->mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+        this->slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// A slot is free for position pos when its sequence is pos, and holds the
+// command pushed at pos when it is pos + 1. A sequence below pos means
+// the consumer has not taken the command from the previous round yet.
+uint64_t CameraCommandQueue::Push(int type, double value, const std::shared_ptr<std::promise<bool> >& done)
+{
+    size_t pos = this->tail.load(std::memory_order_relaxed);
+    slot* s;
+    while (true)
+    {
+        s = &this->slots[pos & this->mask];
+        size_t sequence = s->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (this->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+            return 0;
+        else
+            pos = this->tail.load(std::memory_order_relaxed);
+    }
+
+    s->command.type = type;
+    s->command.value = value;
+    s->command.ticket = pos + 1;
+    s->command.done = done;
+    s->sequence.store(pos + 1, std::memory_order_release);
+    return pos + 1;
+}
+
+bool CameraCommandQueue::Pop(camera_command* command, uint64_t last)
+{
+    if (this->head + 1 > last)
+        return false;
+
+    slot* s = &this->slots[this->head & this->mask];
+    if (s->sequence.load(std::memory_order_acquire) != this->head + 1)
+        return false;
+
+    *command = s->command;
+    s->command.done.reset();
+    s->sequence.store(this->head + this->mask + 1, std::memory_order_release);
+    this->head++;
+    return true;
+}
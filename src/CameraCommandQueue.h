@@ -0,0 +1,93 @@
+#ifndef __CAMERACOMMANDQUEUE_H__
+#define __CAMERACOMMANDQUEUE_H__
+
+/*
+Lock-free queue of camera commands from other threads
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+enum camera_command_type {
+    CAMERA_GO_TO_BOOKMARK,      // value: fly target 1-4
+    CAMERA_SET_SPEED,           // value: max speed
+    CAMERA_TURNTABLE,           // value: model rotation speed, 0 stops
+    CAMERA_SET_VIEW_ANGLE       // value: degrees
+};
+
+struct camera_command {
+    int type;
+    double value;
+    uint64_t ticket;            // position in the queue plus one, increasing
+    std::shared_ptr<std::promise<bool> > done;   // NULL when nobody waits
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Bounded multi-producer, single-consumer ring of camera commands. Push()
+// may be called from any thread and never blocks or takes a lock: a
+// producer claims a slot with a compare-and-swap on the tail and
+// publishes it through the slot's sequence number. Pop() is only called
+// from the interactor thread. When the ring is full Push() fails rather
+// than waiting for the consumer.
+class CameraCommandQueue {
+public:
+    // capacity is rounded up to a power of two
+    CameraCommandQueue(size_t capacity = 256);
+
+    // The command's ticket, or 0 when the queue is full
+    uint64_t Push(int type, double value, const std::shared_ptr<std::promise<bool> >& done);
+
+    // Oldest command if its ticket is at most last, false otherwise or
+    // when the queue is empty
+    bool Pop(camera_command* command, uint64_t last);
+
+    // Ticket of the most recent Push(), complete or not
+    uint64_t GetLastTicket() const { return this->tail.load(std::memory_order_acquire); }
+
+private:
+    struct slot {
+        std::atomic<size_t> sequence;
+        camera_command command;
+    };
+
+    std::unique_ptr<slot[]> slots;
+    size_t mask;
+    std::atomic<size_t> tail;   // next position to push
+    size_t head;                // next position to pop, consumer only
+};
+
+#endif
@@ -0,0 +1,286 @@
+/*
+Camera broadcast for tiled displays and multi-node rendering
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "CameraSync.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+
+static bool setNonBlocking(int sock)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static bool validPacket(const camera_sync_packet* packet, ssize_t bytes)
+{
+    return bytes == sizeof(camera_sync_packet) &&
+        packet->magic == CAMERA_SYNC_MAGIC &&
+        packet->version == CAMERA_SYNC_VERSION;
+}
+
+// Tells processes apart, also several on one host
+static uint32_t processId()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint32_t)getpid() << 16) ^ (uint32_t)ts.tv_nsec;
+}
+
+static double nowMilliseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000.0 + ts.tv_nsec/1e6;
+}
+
+// ----------------------------------------------------------------------------
+CameraSyncLeader::CameraSyncLeader() : sock(-1), session(processId()), sequence(0)
+{
+    memset(&this->groupAddr, 0, sizeof(this->groupAddr));
+}
+
+CameraSyncLeader::~CameraSyncLeader()
+{
+    if (this->sock >= 0)
+        close(this->sock);
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Setup the socket for sending to the multicast group. Packets are looped
+// back, so followers on the same host receive them as well.
+bool CameraSyncLeader::Open(const char* group, int port)
+{
+    this->groupAddr.sin_family = AF_INET;
+    this->groupAddr.sin_port = htons(port);
+    if (inet_pton(AF_INET, group, &this->groupAddr.sin_addr) != 1)
+    {
+        std::cout << "WARNING: invalid camera sync group " << group << std::endl;
+        return false;
+    }
+
+    this->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (this->sock < 0)
+    {
+        std::cout << "WARNING: camera sync socket could not be created: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    unsigned char ttl = 1;
+    unsigned char loop = 1;
+    setsockopt(this->sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(this->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    setNonBlocking(this->sock);
+
+    std::cout << "Broadcasting camera to " << group << ":" << port << std::endl;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Fill in the header and send. A full socket buffer simply drops the
+// packet, followers pick up the next one.
+void CameraSyncLeader::Publish(camera_sync_packet* packet)
+{
+    if (this->sock < 0)
+        return;
+
+    packet->magic = CAMERA_SYNC_MAGIC;
+    packet->version = CAMERA_SYNC_VERSION;
+    packet->type = CAMERA_SYNC_POSE;
+    packet->sequence = ++this->sequence;
+    packet->session = this->session;
+    packet->sender = 0;
+
+    sendto(this->sock, packet, sizeof(*packet), 0, (sockaddr*)&this->groupAddr, sizeof(this->groupAddr));
+    this->ready.clear();
+}
+
+// ----------------------------------------------------------------------------
+bool CameraSyncLeader::WaitForFollowers(int count, double timeout)
+{
+    if (this->sock < 0 || count <= 0)
+        return true;
+
+    double deadline = nowMilliseconds() + timeout;
+    while ((int)this->ready.size() < count)
+    {
+        camera_sync_packet packet;
+        sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        ssize_t bytes = recvfrom(this->sock, &packet, sizeof(packet), 0, (sockaddr*)&from, &fromLen);
+
+        if (bytes < 0)
+        {
+            double remaining = deadline - nowMilliseconds();
+            if (remaining <= 0)
+                return false;
+            pollfd pfd = { this->sock, POLLIN, 0 };
+            poll(&pfd, 1, (int)remaining + 1);
+            continue;
+        }
+
+        if (!validPacket(&packet, bytes) || packet.type != CAMERA_SYNC_READY ||
+            packet.session != this->session || packet.sequence != this->sequence)
+            continue;
+
+        // Count each follower once
+        bool known = false;
+        for (size_t i = 0; i < this->ready.size(); i++)
+            known |= this->ready[i] == packet.sender;
+        if (!known)
+            this->ready.push_back(packet.sender);
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+CameraSyncFollower::CameraSyncFollower() : sock(-1), haveLeader(false), haveSequence(false), session(0), sequence(0),
+                                           id(processId())
+{
+    memset(&this->leaderAddr, 0, sizeof(this->leaderAddr));
+}
+
+CameraSyncFollower::~CameraSyncFollower()
+{
+    if (this->sock >= 0)
+        close(this->sock);
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Join the multicast group. Several followers on one host can share the
+// port, which is how the broadcast is tested on loopback.
+bool CameraSyncFollower::Open(const char* group, int port)
+{
+    ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1)
+    {
+        std::cout << "WARNING: invalid camera sync group " << group << std::endl;
+        return false;
+    }
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+    this->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (this->sock < 0)
+    {
+        std::cout << "WARNING: camera sync socket could not be created: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(this->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(this->sock, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        setsockopt(this->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+    {
+        std::cout << "WARNING: could not join camera sync group " << group << ":" << port << ": " << strerror(errno) << std::endl;
+        close(this->sock);
+        this->sock = -1;
+        return false;
+    }
+
+    setNonBlocking(this->sock);
+
+    std::cout << "Following camera from " << group << ":" << port << std::endl;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+bool CameraSyncFollower::Receive(camera_sync_packet* packet)
+{
+    if (this->sock < 0)
+        return false;
+
+    bool received = false;
+    camera_sync_packet incoming;
+    sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t bytes;
+
+    while ((bytes = recvfrom(this->sock, &incoming, sizeof(incoming), 0, (sockaddr*)&from, &fromLen)) >= 0)
+    {
+        fromLen = sizeof(from);
+        if (!validPacket(&incoming, bytes) || incoming.type != CAMERA_SYNC_POSE)
+            continue;
+
+        // Sequence numbers wrap, compare through the signed difference
+        if (this->haveSequence && incoming.session == this->session &&
+            (int32_t)(incoming.sequence - this->sequence) <= 0)
+            continue;
+
+        *packet = incoming;
+        this->session = incoming.session;
+        this->sequence = incoming.sequence;
+        this->haveSequence = true;
+        this->leaderAddr = from;
+        this->haveLeader = true;
+        received = true;
+    }
+
+    return received;
+}
+
+// ----------------------------------------------------------------------------
+void CameraSyncFollower::SendReady()
+{
+    if (this->sock < 0 || !this->haveLeader)
+        return;
+
+    camera_sync_packet packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.magic = CAMERA_SYNC_MAGIC;
+    packet.version = CAMERA_SYNC_VERSION;
+    packet.type = CAMERA_SYNC_READY;
+    packet.sequence = this->sequence;
+    packet.session = this->session;
+    packet.sender = this->id;
+
+    sendto(this->sock, &packet, sizeof(packet), 0, (sockaddr*)&this->leaderAddr, sizeof(this->leaderAddr));
+}
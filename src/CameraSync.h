@@ -0,0 +1,119 @@
+#ifndef __CAMERASYNC_H__
+#define __CAMERASYNC_H__
+
+/*
+Camera broadcast for tiled displays and multi-node rendering
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <vector>
+
+#define CAMERA_SYNC_MAGIC   0x56544b47  /* "VTKG" */
+#define CAMERA_SYNC_VERSION 2
+
+#define CAMERA_SYNC_POSE    0x01    /* leader -> followers: camera pose */
+#define CAMERA_SYNC_READY   0x02    /* follower -> leader: frame rendered */
+
+// Sent once per tick by the leader. Nodes of a display wall share an
+// architecture, so the packet is in native byte order; the magic number
+// rejects anything else. Sequence numbers count per session, a restarted
+// leader starts a new session from 1.
+struct camera_sync_packet {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t sequence;
+    uint32_t session;       // random id of the leader process
+    uint32_t sender;        // follower id in ready messages
+    double position[3];
+    double focalPoint[3];
+    double viewUp[3];
+    double viewAngle;
+    double modelTransform[16];  // row major, identity without a model
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Publishes camera packets to a multicast group. Sending never blocks;
+// waiting for followers is optional and bounded by a timeout. The wait
+// is best-effort frame pacing, not a swap lock: it keeps followers from
+// falling behind, but they do not wait for each other before swapping.
+class CameraSyncLeader {
+public:
+    CameraSyncLeader();
+    ~CameraSyncLeader();
+    bool Open(const char* group, int port);
+    void Publish(camera_sync_packet* packet);
+
+    // Wait at most timeout milliseconds until count followers reported
+    // the last published frame as rendered. Returns false on timeout.
+    bool WaitForFollowers(int count, double timeout);
+
+private:
+    int sock;
+    sockaddr_in groupAddr;
+    uint32_t session;
+    uint32_t sequence;
+    std::vector<uint32_t> ready;
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Receives camera packets from a multicast group
+class CameraSyncFollower {
+public:
+    CameraSyncFollower();
+    ~CameraSyncFollower();
+    bool Open(const char* group, int port);
+
+    // Drain all pending packets. Returns true and the newest pose when a
+    // packet newer than the last one returned arrived; late packets are
+    // dropped. A packet from another leader session is always taken, so
+    // a restarted leader is followed right away.
+    bool Receive(camera_sync_packet* packet);
+
+    // Tell the leader the last received frame has been rendered
+    void SendReady();
+
+private:
+    int sock;
+    bool haveLeader;
+    sockaddr_in leaderAddr;
+    bool haveSequence;
+    uint32_t session;
+    uint32_t sequence;
+    uint32_t id;    // followers on one host share address and port
+};
+
+#endif
@@ -0,0 +1,234 @@
+/*
+Distance-to-geometry grid for automatic speed scaling
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ClearanceField.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <thread>
+#include <time.h>
+
+// ----------------------------------------------------------------------------
+ClearanceField::ClearanceField() : resolution(32), refinement(8), restartInterval(0.5), cancel(false),
+    coarseVersion(-1), fineVersion(-1), coarseGeometry(-1), fineGeometry(-1), coarseStart(0), fineStart(0)
+{
+    this->fineCenter[0] = this->fineCenter[1] = this->fineCenter[2] = 0;
+}
+
+ClearanceField::~ClearanceField()
+{
+    // Make running jobs quick and wait for them while cancel still exists
+    this->cancel = true;
+    if (this->coarseJob.valid())
+        this->coarseJob.wait();
+    if (this->fineJob.valid())
+        this->fineJob.wait();
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Distance at every grid point, slices divided over the threads.
+// Distances are capped at the grid's own extent, beyond that the value
+// does not matter for speed scaling.
+std::shared_ptr<ClearanceField::grid> ClearanceField::Compute(std::vector<bvh_instance> instances, std::shared_ptr<grid> g,
+                                                              int threads, std::atomic<bool>* cancel)
+{
+    int n = g->n;
+    double spacing = g->spacing;
+    g->values.resize(n*n*n);
+
+    double maxDistance = spacing*n*sqrt(3.0);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([&, t]() {
+            for (int k = t; k < n && !*cancel; k += threads)
+                for (int j = 0; j < n; j++)
+                    for (int i = 0; i < n; i++)
+                    {
+                        double p[3] = { g->origin[0] + i*spacing, g->origin[1] + j*spacing, g->origin[2] + k*spacing };
+                        g->values[(k*n + j)*n + i] = SceneBVH::Distance(instances, p, maxDistance, 1 << 16);
+                    }
+        }));
+    }
+    for (int t = 0; t < threads; t++)
+        workers[t].join();
+
+    return g;
+}
+
+// The job gets its own copy of the instances and the grid header
+std::future<std::shared_ptr<ClearanceField::grid> > ClearanceField::Start(const SceneBVH* scene, const double* origin, double spacing,
+                                                                          bool allCores)
+{
+    std::shared_ptr<grid> g = std::make_shared<grid>();
+    std::copy(origin, origin + 3, g->origin);
+    g->spacing = spacing;
+    g->n = this->resolution;
+    int threads = allCores ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    return std::async(std::launch::async, &ClearanceField::Compute, scene->GetInstances(), g, threads, &this->cancel);
+}
+
+// ----------------------------------------------------------------------------
+static double monotonicSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+template <class T> static bool finished(std::future<T>& job)
+{
+    return job.valid() && job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void ClearanceField::Update(const SceneBVH* scene, const double* camera)
+{
+    // Adopt finished grids
+    if (finished(this->coarseJob))
+        this->coarse = this->coarseJob.get();
+    if (finished(this->fineJob))
+        this->fine = this->fineJob.get();
+
+    double bounds[6];
+    if (!scene->GetBounds(bounds))
+        return;
+
+    // Whole scene, padded by a couple of cells on each side
+    double size = std::max(bounds[1] - bounds[0], std::max(bounds[3] - bounds[2], bounds[5] - bounds[4]));
+    double spacing = std::max(size, 1e-6)/(this->resolution - 5);
+    unsigned long version = scene->GetVersion();
+    unsigned long geometry = scene->GetGeometryVersion();
+    double now = monotonicSeconds();
+
+    // A scene that keeps changing (an animated or rotated model bumps the
+    // version every tick) restarts the grids at most every restartInterval,
+    // otherwise the workers would never rest. Only new geometry or a
+    // missing grid is worth all cores.
+    if (version != this->coarseVersion && !this->coarseJob.valid() && now - this->coarseStart >= this->restartInterval)
+    {
+        double origin[3] = { bounds[0] - 2*spacing, bounds[2] - 2*spacing, bounds[4] - 2*spacing };
+        bool allCores = this->coarse == NULL || geometry != this->coarseGeometry;
+        this->coarseJob = this->Start(scene, origin, spacing, allCores);
+        this->coarseVersion = version;
+        this->coarseGeometry = geometry;
+        this->coarseStart = now;
+    }
+
+    // Brick around the camera, recentered once the camera has moved a
+    // quarter of its size
+    double fineSpacing = spacing/this->refinement;
+    double extent = fineSpacing*(this->resolution - 1);
+    double moved = 0;
+    for (int k = 0; k < 3; k++)
+        moved = std::max(moved, fabs(camera[k] - this->fineCenter[k]));
+
+    bool stale = version != this->fineVersion && now - this->fineStart >= this->restartInterval;
+    bool recenter = moved > extent/4;
+    if ((stale || recenter) && !this->fineJob.valid())
+    {
+        double origin[3];
+        for (int k = 0; k < 3; k++)
+        {
+            this->fineCenter[k] = floor(camera[k]/fineSpacing + 0.5)*fineSpacing;
+            origin[k] = this->fineCenter[k] - extent/2;
+        }
+        bool allCores = recenter || this->fine == NULL || geometry != this->fineGeometry;
+        this->fineJob = this->Start(scene, origin, fineSpacing, allCores);
+        this->fineVersion = version;
+        this->fineGeometry = geometry;
+        this->fineStart = now;
+    }
+}
+
+// ----------------------------------------------------------------------------
+bool ClearanceField::Inside(const grid* g, const double* p, double margin)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        double x = (p[k] - g->origin[k])/g->spacing;
+        if (x < margin || x > g->n - 1 - margin)
+            return false;
+    }
+    return true;
+}
+
+// Trilinear interpolation, p is clamped to the grid
+double ClearanceField::Interpolate(const grid* g, const double* p)
+{
+    int i[3];
+    double f[3];
+    for (int k = 0; k < 3; k++)
+    {
+        double x = std::min(std::max((p[k] - g->origin[k])/g->spacing, 0.0), g->n - 1.000001);
+        i[k] = (int)x;
+        f[k] = x - i[k];
+    }
+
+    int n = g->n;
+    const float* v = &g->values[(i[2]*n + i[1])*n + i[0]];
+    double c00 = v[0]*(1 - f[0]) + v[1]*f[0];
+    double c10 = v[n]*(1 - f[0]) + v[n+1]*f[0];
+    double c01 = v[n*n]*(1 - f[0]) + v[n*n+1]*f[0];
+    double c11 = v[n*n+n]*(1 - f[0]) + v[n*n+n+1]*f[0];
+    double c0 = c00*(1 - f[1]) + c10*f[1];
+    double c1 = c01*(1 - f[1]) + c11*f[1];
+    return c0*(1 - f[2]) + c1*f[2];
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Prefer the brick, then the coarse grid. Outside the coarse grid the
+// clearance is at least the distance to the grid, so that is added to
+// the value at the nearest grid point.
+double ClearanceField::Sample(const double* p) const
+{
+    const grid* f = this->fine.get();
+    if (f != NULL && Inside(f, p, 1.0))
+        return Interpolate(f, p);
+
+    const grid* c = this->coarse.get();
+    if (c == NULL)
+        return f != NULL ? Interpolate(f, p) : -1.0;
+
+    double outside = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        double lo = c->origin[k], hi = c->origin[k] + c->spacing*(c->n - 1);
+        double e = std::max(std::max(lo - p[k], p[k] - hi), 0.0);
+        outside += e*e;
+    }
+    return Interpolate(c, p) + sqrt(outside);
+}
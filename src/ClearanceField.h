@@ -0,0 +1,99 @@
+#ifndef __CLEARANCEFIELD_H__
+#define __CLEARANCEFIELD_H__
+
+/*
+Distance-to-geometry grid for automatic speed scaling
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SceneBVH.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// Description:
+// Clearance (distance to the nearest surface) sampled on two grids: a
+// coarse one over the whole scene and a finer brick that follows the
+// camera. Both are computed on worker threads from a snapshot of the
+// scene BVH; Sample() only reads the finished grids, so it is O(1) and
+// never waits. Memory is two grids of resolution^3 floats, independent
+// of the scene size.
+class ClearanceField {
+public:
+    ClearanceField();
+    ~ClearanceField();
+
+    // Called once per tick on the interactor thread. Starts a new coarse
+    // grid when the scene changed (at most every restartInterval) and a
+    // new brick when the camera left the middle of the current one. A
+    // grid restarted only because props moved is computed by a single
+    // worker: a turntable or animation moves props every tick, and that
+    // must not keep all cores busy.
+    void Update(const SceneBVH* scene, const double* camera);
+
+    // Interpolated clearance at p, or a negative value before the first
+    // grid is ready
+    double Sample(const double* p) const;
+
+    int resolution;     // samples per axis, for both grids
+    int refinement;     // coarse spacing / brick spacing
+    double restartInterval;     // seconds between grids started for scene changes
+
+private:
+    struct grid {
+        double origin[3];
+        double spacing;
+        int n;
+        std::vector<float> values;
+    };
+
+    static std::shared_ptr<grid> Compute(std::vector<bvh_instance> instances, std::shared_ptr<grid> g, int threads,
+                                         std::atomic<bool>* cancel);
+    std::future<std::shared_ptr<grid> > Start(const SceneBVH* scene, const double* origin, double spacing,
+                                              bool allCores);
+    static bool Inside(const grid* g, const double* p, double margin);
+    static double Interpolate(const grid* g, const double* p);
+
+    // Declared before the jobs, which use it until they are destroyed
+    std::atomic<bool> cancel;
+    std::shared_ptr<grid> coarse, fine;
+    std::future<std::shared_ptr<grid> > coarseJob, fineJob;
+    unsigned long coarseVersion, fineVersion;     // scene version each grid was started for
+    unsigned long coarseGeometry, fineGeometry;   // and its geometry version
+    double coarseStart, fineStart;                // when each grid was last started
+    double fineCenter[3];
+};
+
+#endif
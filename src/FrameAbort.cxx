@@ -0,0 +1,61 @@
+/*
+When to abort a frame for newer input
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "FrameAbort.h"
+
+#include <math.h>
+
+// ----------------------------------------------------------------------------
+void FrameAbort::Start()
+{
+    this->abortedInRow = this->aborted ? this->abortedInRow + 1 : 0;
+    this->aborted = false;
+}
+
+void FrameAbort::Reset()
+{
+    this->aborted = false;
+    this->abortedInRow = 0;
+}
+
+bool FrameAbort::GamepadChanged(const gp_state& start, const gp_state& now, double threshold)
+{
+    if (now.button != start.button || now.axis.size() != start.axis.size())
+        return true;
+
+    double range = threshold*32767;
+    for (size_t i = 0; i < now.axis.size() && i < 4; i++)
+        if (fabs((double)now.axis[i] - start.axis[i]) > range)
+            return true;
+    return false;
+}
@@ -0,0 +1,76 @@
+#ifndef __FRAMEABORT_H__
+#define __FRAMEABORT_H__
+
+/*
+When to abort a frame for newer input
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GamepadHandler.h"
+
+// ----------------------------------------------------------------------------
+// Description:
+// Abort decisions of interruptible rendering, kept apart from the render
+// window so they can be tested. Start() is called when a frame starts,
+// MayAbort() and Abort() on its abort checks. A frame counts as aborted
+// from the first Abort() on; the count of aborted frames in a row is
+// settled by the next Start(). Once maxAborted frames in a row were
+// aborted the next frame is not, so continuous input cannot keep the
+// display from updating.
+class FrameAbort {
+public:
+    FrameAbort() : aborted(false), abortedInRow(0) {}
+
+    void Start();
+
+    // False when the frame was aborted already or the previous maxAborted
+    // frames all were
+    bool MayAbort(int maxAborted) const { return !this->aborted && this->abortedInRow < maxAborted; }
+
+    void Abort() { this->aborted = true; }
+
+    // Forget the history, for a new render window
+    void Reset();
+
+    bool Aborted() const { return this->aborted; }
+
+    // True when a button changed, the number of axes changed or one of
+    // the sticks (axes 0-3, the rest is the d-pad) moved more than
+    // threshold, a fraction of the axis range
+    static bool GamepadChanged(const gp_state& start, const gp_state& now, double threshold);
+
+private:
+    bool aborted;           // the current frame
+    int abortedInRow;       // frames before the current one
+};
+
+#endif
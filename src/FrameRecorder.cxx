@@ -0,0 +1,197 @@
+/*
+Pipelined frame capture for recording fly-throughs
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "FrameRecorder.h"
+
+#include "vtkImageData.h"
+#include "vtkPNGWriter.h"
+#include "vtkPointData.h"
+#include "vtkSmartPointer.h"
+#include "vtkUnsignedCharArray.h"
+#include <algorithm>
+#include <ctype.h>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+// ----------------------------------------------------------------------------
+FrameRecorder::FrameRecorder(const char* pattern, int buffers, int threads)
+    : pattern(pattern), frames(std::max(buffers, 1)), running(true), nextNumber(0)
+{
+    this->stats = record_stats();
+    for (size_t i = 0; i < this->frames.size(); i++)
+    {
+        this->frames[i].width = this->frames[i].height = 0;
+        this->idle.push_back(i);
+    }
+    for (int i = 0; i < std::max(threads, 1); i++)
+        this->writers.push_back(std::thread(&FrameRecorder::Write, this));
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+    this->wake.notify_all();
+    for (size_t i = 0; i < this->writers.size(); i++)
+        this->writers[i].join();
+}
+
+// ----------------------------------------------------------------------------
+bool FrameRecorder::ValidPattern(const char* pattern)
+{
+    if (pattern == NULL)
+        return false;
+    int conversions = 0;
+    for (const char* c = pattern; *c != '\0'; c++)
+    {
+        if (*c != '%')
+            continue;
+        c++;
+        if (*c == '%')
+            continue;
+        while (*c != '\0' && strchr("-+ #0", *c) != NULL)
+            c++;
+        while (isdigit((unsigned char)*c))
+            c++;
+        if (*c == '.')
+        {
+            c++;
+            while (isdigit((unsigned char)*c))
+                c++;
+        }
+        if (*c == '\0' || strchr("diouxX", *c) == NULL)
+            return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// ----------------------------------------------------------------------------
+int FrameRecorder::Acquire()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->idle.empty())
+    {
+        this->stats.stalls++;
+        return -1;
+    }
+    int id = this->idle.back();
+    this->idle.pop_back();
+    return id;
+}
+
+// The buffer belongs to the caller between Acquire() and Submit(), so no
+// lock is needed here
+unsigned char* FrameRecorder::Buffer(int id, int width, int height)
+{
+    frame& f = this->frames[id];
+    f.width = width;
+    f.height = height;
+    f.pixels.resize((size_t)width*height*3);
+    return f.pixels.data();
+}
+
+void FrameRecorder::Submit(int id)
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->frames[id].number = this->nextNumber++;
+        this->queue.push_back(id);
+        this->stats.captured++;
+    }
+    this->wake.notify_one();
+}
+
+void FrameRecorder::Release(int id)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->idle.push_back(id);
+}
+
+record_stats FrameRecorder::GetStats()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    record_stats stats = this->stats;
+    stats.queued = this->stats.captured - this->stats.written - this->stats.failed;
+    return stats;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Writer thread. The image wraps the frame's buffer, so nothing is copied
+// on the way to the PNG encoder. Frames still queued at shutdown are
+// written before the thread exits.
+void FrameRecorder::Write()
+{
+    vtkSmartPointer<vtkPNGWriter> writer = vtkSmartPointer<vtkPNGWriter>::New();
+    std::vector<char> name(this->pattern.size() + 32);
+
+    std::unique_lock<std::mutex> guard(this->lock);
+    while (true)
+    {
+        this->wake.wait(guard, [this]() { return !this->running || !this->queue.empty(); });
+        if (this->queue.empty())
+            break;
+
+        int id = this->queue.front();
+        this->queue.pop_front();
+        frame& f = this->frames[id];
+        guard.unlock();
+
+        vtkSmartPointer<vtkUnsignedCharArray> pixels = vtkSmartPointer<vtkUnsignedCharArray>::New();
+        pixels->SetNumberOfComponents(3);
+        pixels->SetArray(f.pixels.data(), (vtkIdType)f.width*f.height*3, 1);
+        vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+        image->SetDimensions(f.width, f.height, 1);
+        image->GetPointData()->SetScalars(pixels);
+
+        snprintf(name.data(), name.size(), this->pattern.c_str(), (int)f.number);
+        writer->SetFileName(name.data());
+        writer->SetInputData(image);
+        writer->Write();
+        writer->SetInputData(NULL);
+        bool ok = writer->GetErrorCode() == 0;
+        if (!ok)
+            std::cerr << "Could not write frame " << name.data() << std::endl;
+
+        guard.lock();
+        if (ok)
+            this->stats.written++;
+        else
+            this->stats.failed++;
+        this->idle.push_back(id);
+    }
+}
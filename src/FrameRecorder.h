@@ -0,0 +1,110 @@
+#ifndef __FRAMERECORDER_H__
+#define __FRAMERECORDER_H__
+
+/*
+Pipelined frame capture for recording fly-throughs
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct record_stats {
+    uint64_t captured;          // frames submitted
+    uint64_t written;
+    uint64_t failed;            // could not be written
+    uint64_t stalls;            // Acquire() found no free buffer
+    uint64_t queued;            // submitted, not written yet
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Writes rendered frames to numbered PNG files without holding up the
+// render thread. Frames are read back into one of a few reusable buffers
+// (Acquire(), Buffer(), Submit()); worker threads compress and write
+// them and hand the buffers back. When all buffers are waiting for the
+// encoder, Acquire() fails instead of blocking, the caller decides
+// whether to skip the frame or to wait with advancing the animation.
+class FrameRecorder {
+public:
+    // pattern is a printf format for the file names with one integer
+    // conversion for the frame number, e.g. "frames/%05d.png"
+    FrameRecorder(const char* pattern, int buffers = 4, int threads = 2);
+
+    // Waits until all submitted frames are written
+    ~FrameRecorder();
+
+    // True when pattern has exactly one integer conversion (%d, %05d, %x,
+    // ... without a length modifier) and no other conversion than %%
+    static bool ValidPattern(const char* pattern);
+
+    // A free buffer, or -1 when all of them are queued or being written
+    int Acquire();
+
+    // Storage for an RGB frame of width x height in buffer id, bottom row
+    // first. Reallocates only when the frame grew.
+    unsigned char* Buffer(int id, int width, int height);
+
+    // Queue buffer id as the next frame, or give it back unused
+    void Submit(int id);
+    void Release(int id);
+
+    record_stats GetStats();
+
+private:
+    struct frame {
+        std::vector<unsigned char> pixels;
+        int width, height;
+        uint64_t number;
+    };
+
+    void Write();
+
+    std::string pattern;
+    std::vector<frame> frames;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool running;
+    std::vector<int> idle;           // buffers not in use
+    std::deque<int> queue;
+    uint64_t nextNumber;
+    record_stats stats;
+    std::vector<std::thread> writers;
+};
+
+#endif
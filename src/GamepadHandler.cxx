@@ -34,7 +34,28 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "GamepadHandler.h"
 
-GamepadHandler::GamepadHandler() : gamepadID(0), gamepadEv(0), gamepadState(0), version(0), axes(0), buttons(0), thread(0), reading(false)
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+// ----------------------------------------------------------------------------
+static double monotonicSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// ----------------------------------------------------------------------------
+GamepadHandler::GamepadHandler() : gamepadID(0), gamepadEv(0), gamepadState(0), version(0), axes(0), buttons(0), thread(0), reading(false),
+                                   tid(0)
 {
     this->openDevice(); // Find and setup IO
     this->startReading(); // Read IO in thread
@@ -42,7 +63,7 @@ GamepadHandler::GamepadHandler() : gamepadID(0), gamepadEv(0), gamepadState(0),
 
 GamepadHandler::~GamepadHandler()
 {
-    if (gamepadID > 0) 
+    if (gamepadID > 0 && this->thread != 0)
     {
         this->reading = false;
         pthread_join(thread, 0);
@@ -67,9 +88,10 @@ void GamepadHandler::openDevice()
     this->gamepadState = new gp_state(); // gp event struct {buttons and axis}
     this->gamepadID = open(JOYSTICK_DEV, O_RDONLY | O_NONBLOCK);
     
-    if (this->gamepadID == 0)        
+    if (this->gamepadID < 0)
     {
         std::cout << "WARNING: gamepad device could not be opened!" << std::endl;
+        this->gamepadID = 0;
         return;
     }
         
@@ -84,10 +106,12 @@ void GamepadHandler::openDevice()
     std::cout << "   Axes: " << (int)this->axes << std::endl;
     std::cout << "Buttons: " << (int)this->buttons << std::endl;
     
-    this->gamepadState->axis.reserve(this->axes);
-    this->gamepadState->button.reserve(this->buttons);
+    // The interactor style reads fixed axis and button numbers, so keep
+    // at least that many even for smaller devices
+    this->gamepadState->axis.resize(std::max((int)this->axes, 8), 0);
+    this->gamepadState->button.resize(std::max((int)this->buttons, 12), 0);
     
-    std::cout << "Printing gamepad state with " << gamepadState->button.capacity() << " buttons and " << gamepadState->axis.capacity() << " axes: " << std::endl;
+    std::cout << "Printing gamepad state with " << gamepadState->button.size() << " buttons and " << gamepadState->axis.size() << " axes: " << std::endl;
 }
 
 // ----------------------------------------------------------------------------
@@ -101,32 +125,71 @@ void GamepadHandler::startReading()
         return;
     }
     
-    pthread_create(&(this->thread), 0, &GamepadHandler::readEvents, this); 
+    // Set before the thread looks at it
     this->reading = true;
+    pthread_t thread;
+    int error = pthread_create(&thread, 0, &GamepadHandler::readEvents, this);
+    if (error != 0)
+    {
+        std::cout << "WARNING: gamepad reader thread not started: " << strerror(error) << std::endl;
+        this->reading = false;
+        return;
+    }
+    this->thread = thread;
 }
 
 // ----------------------------------------------------------------------------
 // Description:
-// Continues loop reading gamepad state until gamepad is deleted
+// Continues loop reading gamepad state until gamepad is deleted. The
+// thread sleeps in poll() until the device has events, waking up at
+// least every 100 ms to see whether it should stop. When the device
+// fails (unplugged, a read error) the thread stops and the gamepad is
+// no longer active.
 void* GamepadHandler::readEvents(void *obj) 
 {
     int bytes;
     
     GamepadHandler* gp =  reinterpret_cast<GamepadHandler *>(obj);
+    gp->tid = syscall(SYS_gettid);
     while(gp->reading)
     {
+        pollfd fd = { gp->gamepadID, POLLIN, 0 };
+        int ready = poll(&fd, 1, 100);
+        if (ready < 0 && errno != EINTR)
+        {
+            std::cout << "WARNING: gamepad poll failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (ready > 0 && (fd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+        {
+            std::cout << "WARNING: gamepad device lost" << std::endl;
+            break;
+        }
+
+        // Take everything queued, moving a stick produces far more than
+        // one event per sleep
         bytes = read(gp->gamepadID, gp->gamepadEv, sizeof(*(gp->gamepadEv)));
-        if (bytes > 0) 
+        while (bytes > 0) 
         {
             gp->gamepadEv->type &= ~JS_EVENT_INIT;
-            if (gp->gamepadEv->type & JS_EVENT_BUTTON)
-                gp->gamepadState->button[gp->gamepadEv->number] = gp->gamepadEv->value;
+            {
+                std::lock_guard<std::mutex> guard(gp->stateLock);
+                if (gp->gamepadEv->type & JS_EVENT_BUTTON)
+                    gp->gamepadState->button[gp->gamepadEv->number] = gp->gamepadEv->value;
+                if (gp->gamepadEv->type & JS_EVENT_AXIS)
+                    gp->gamepadState->axis[gp->gamepadEv->number] = gp->gamepadEv->value;
+            }
             if (gp->gamepadEv->type & JS_EVENT_AXIS)
-                gp->gamepadState->axis[gp->gamepadEv->number] = gp->gamepadEv->value;
+                gp->recordAxis(gp->gamepadEv);
+            bytes = read(gp->gamepadID, gp->gamepadEv, sizeof(*(gp->gamepadEv)));
+        }
+        if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            std::cout << "WARNING: gamepad read failed: " << strerror(errno) << std::endl;
+            break;
         }
-        
-        usleep(10000);
     }
+    gp->reading = false;
     
     std::cout << "GamepadHandler::readEvents() done" << std::endl;
     
@@ -138,6 +201,7 @@ void* GamepadHandler::readEvents(void *obj)
     }
     
     std::cout << "GamepadHandler::readEvents() returned" << std::endl;
+    return 0;
 }
 
 // ----------------------------------------------------------------------------
@@ -152,3 +216,216 @@ bool GamepadHandler::IsActive()
 {
     return this->reading;
 }
+
+void GamepadHandler::copyGamepadState(gp_state* copy)
+{
+    std::lock_guard<std::mutex> guard(this->stateLock);
+    if (this->gamepadState != NULL)
+        *copy = *this->gamepadState;
+    else
+        *copy = gp_state();
+}
+
+// ----------------------------------------------------------------------------
+EventClock::EventClock() : maxLatency(0.1), drift(1e-3), started(false), lastTime(0), eventSeconds(0), offset(0), lastNow(0)
+{
+}
+
+double EventClock::Map(__u32 time, double now)
+{
+    if (!this->started)
+        this->eventSeconds = time/1000.0;
+    else
+        this->eventSeconds += (__s32)(time - this->lastTime)/1000.0;
+    this->lastTime = time;
+
+    double difference = now - this->eventSeconds;
+    if (!this->started || difference - this->offset > this->maxLatency)
+        this->offset = difference;
+    else
+        this->offset = std::min(this->offset + this->drift*(now - this->lastNow), difference);
+    this->started = true;
+    this->lastNow = now;
+
+    return this->eventSeconds + this->offset;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// At most a few seconds of samples are kept when nobody collects them.
+void GamepadHandler::recordAxis(const gp_event* ev)
+{
+    double now = monotonicSeconds();
+
+    gp_axis_sample sample;
+    sample.time = this->eventClock.Map(ev->time, now);
+    sample.delivered = now;
+    sample.number = ev->number;
+    sample.value = ev->value;
+
+    std::lock_guard<std::mutex> guard(this->sampleLock);
+    if (this->samples.size() < 4096)
+        this->samples.push_back(sample);
+}
+
+// Copied rather than swapped, so the reader keeps its (possibly locked)
+// buffer
+void GamepadHandler::getAxisSamples(std::vector<gp_axis_sample>& samples)
+{
+    std::lock_guard<std::mutex> guard(this->sampleLock);
+    samples.assign(this->samples.begin(), this->samples.end());
+    this->samples.clear();
+}
+
+// ----------------------------------------------------------------------------
+void gp_thread_options::setCpus(const char* list)
+{
+    this->cpus.clear();
+    for (const char* p = list; p != NULL && *p; )
+    {
+        char* end;
+        long cpu = strtol(p, &end, 10);
+        if (end == p)
+            break;
+        this->cpus.push_back(cpu);
+        p = *end == ',' ? end + 1 : end;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// SCHED_FIFO falls back to SCHED_OTHER with the nice value when it is not
+// permitted. Memory locking covers the buffers the reader writes and the
+// top of its stack, not the whole process.
+bool GamepadHandler::setThreadOptions(const gp_thread_options& options)
+{
+    // The reader sets tid first thing, unless it stopped already
+    while (this->tid == 0 && this->reading)
+        usleep(100);
+    if (this->tid == 0 || !this->reading)
+        return false;
+
+    bool ok = true;
+    int policy = options.policy;
+    if (policy == SCHED_FIFO)
+    {
+        sched_param param;
+        param.sched_priority = std::min(std::max(options.priority, sched_get_priority_min(SCHED_FIFO)),
+                                        sched_get_priority_max(SCHED_FIFO));
+        int error = pthread_setschedparam(this->thread, SCHED_FIFO, &param);
+        if (error != 0)
+        {
+            std::cout << "WARNING: gamepad reader can not use SCHED_FIFO: " << strerror(error) << std::endl;
+            policy = SCHED_OTHER;
+            ok = false;
+        }
+    }
+    if (policy != SCHED_FIFO)
+    {
+        sched_param param;
+        param.sched_priority = 0;
+        pthread_setschedparam(this->thread, SCHED_OTHER, &param);
+        if (setpriority(PRIO_PROCESS, this->tid, options.nice) != 0)
+        {
+            std::cout << "WARNING: gamepad reader can not use nice " << options.nice << ": " << strerror(errno) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (!options.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (size_t i = 0; i < options.cpus.size(); i++)
+            if (options.cpus[i] >= 0 && options.cpus[i] < CPU_SETSIZE)
+                CPU_SET(options.cpus[i], &cpus);
+        int error = pthread_setaffinity_np(this->thread, sizeof(cpus), &cpus);
+        if (error != 0)
+        {
+            std::cout << "WARNING: gamepad reader CPU affinity not set: " << strerror(error) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (options.lockMemory)
+    {
+        {
+            std::lock_guard<std::mutex> guard(this->sampleLock);
+            this->samples.reserve(4096);
+        }
+
+        bool locked = mlock(this->gamepadEv, sizeof(*this->gamepadEv)) == 0 &&
+            mlock(this->gamepadState->axis.data(), this->gamepadState->axis.size()*sizeof(signed short)) == 0 &&
+            mlock(this->gamepadState->button.data(), this->gamepadState->button.size()*sizeof(signed short)) == 0 &&
+            mlock(this->samples.data(), this->samples.capacity()*sizeof(gp_axis_sample)) == 0;
+
+        pthread_attr_t attr;
+        void* stack;
+        size_t size;
+        if (locked && pthread_getattr_np(this->thread, &attr) == 0)
+        {
+            if (pthread_attr_getstack(&attr, &stack, &size) == 0)
+            {
+                size_t top = std::min(size, (size_t)65536);
+                locked = mlock((char*)stack + size - top, top) == 0;
+            }
+            pthread_attr_destroy(&attr);
+        }
+
+        if (!locked)
+        {
+            std::cout << "WARNING: gamepad reader memory not locked: " << strerror(errno) << std::endl;
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+// ----------------------------------------------------------------------------
+static signed short syntheticAxis(int i, double t)
+{
+    return (signed short)(16000*sin(t*(0.5 + 0.25*i)));
+}
+
+SyntheticGamepad::SyntheticGamepad(int axes, int buttons)
+{
+    this->state.axis.resize(axes, 0);
+    this->state.button.resize(buttons, 0);
+    this->start = monotonicSeconds();
+    this->lastSample = 0;
+}
+
+gp_state* SyntheticGamepad::getGamepadState()
+{
+    double t = monotonicSeconds() - this->start;
+    for (size_t i = 0; i < this->state.axis.size() && i < 4; i++)
+        this->state.axis[i] = syntheticAxis(i, t);
+    if (!this->state.button.empty())
+        this->state.button[0] = fmod(t, 4.0) < 1.0;
+    return &this->state;
+}
+
+bool SyntheticGamepad::IsActive()
+{
+    return true;
+}
+
+void SyntheticGamepad::getAxisSamples(std::vector<gp_axis_sample>& samples)
+{
+    samples.clear();
+    double t = monotonicSeconds() - this->start;
+    for (double s = std::max(this->lastSample, t - 1.0) + 0.001; s <= t; s += 0.001)
+    {
+        this->lastSample = s;
+        for (size_t i = 0; i < this->state.axis.size() && i < 4; i++)
+        {
+            gp_axis_sample sample;
+            sample.time = this->start + s;
+            sample.delivered = sample.time;
+            sample.number = i;
+            sample.value = syntheticAxis(i, s);
+            samples.push_back(sample);
+        }
+    }
+}
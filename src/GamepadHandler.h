@@ -42,6 +42,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <iostream>
 #include <pthread.h>
 #include <linux/joystick.h>
+#include <atomic>
+#include <mutex>
+#include <sched.h>
+#include <sys/types.h>
 #include <vector>
 
 #define JOYSTICK_DEV "/dev/input/js0"
@@ -61,7 +65,68 @@ struct gp_state{
     std::vector<signed short> axis;
 };
 
-class GamepadHandler {
+// One axis change, times in seconds on the CLOCK_MONOTONIC clock
+struct gp_axis_sample {
+    double time;
+    double delivered;       // when the reader thread got it
+    unsigned char number;
+    signed short value;
+};
+
+// Maps the driver's event times, milliseconds on a 32 bit counter of its
+// own, to CLOCK_MONOTONIC seconds. The counter is unwrapped by taking
+// differences modulo 2^32. The offset between the clocks is the smallest
+// difference seen at read time, the rest of a difference is read
+// latency; the estimate creeps up slowly between events and a difference
+// that jumps past it by more than maxLatency restarts it, so a jump of
+// either clock is followed.
+class EventClock {
+public:
+    EventClock();
+    double Map(__u32 time, double now);
+
+    double maxLatency;      // seconds
+    double drift;           // seconds per second the offset may creep up
+
+private:
+    bool started;
+    __u32 lastTime;
+    double eventSeconds;    // unwrapped event time
+    double offset;
+    double lastNow;
+};
+
+// Scheduling of the reader thread. Settings the system refuses (no
+// CAP_SYS_NICE, a small RLIMIT_MEMLOCK, CPUs that do not exist) are
+// reported and skipped, reading works either way.
+struct gp_thread_options {
+    gp_thread_options() : policy(SCHED_OTHER), priority(10), nice(0), lockMemory(false) {}
+    void setCpus(const char* list);     // comma separated, e.g. "2,3"
+    int policy;             // SCHED_OTHER or SCHED_FIFO
+    int priority;           // SCHED_FIFO priority
+    int nice;               // SCHED_OTHER nice value, -20 to 19
+    std::vector<int> cpus;  // CPUs the thread may run on, empty for any
+    bool lockMemory;        // keep the reader's stack and buffers resident
+};
+
+// Anything that can feed gamepad state to the interactor style
+class GamepadSource {
+public:
+    virtual ~GamepadSource() {}
+    virtual gp_state* getGamepadState() = 0;
+    virtual bool IsActive() = 0;
+
+    // Copy of the current state, consistent even while a reader thread
+    // updates it. Sources without such a thread copy getGamepadState().
+    virtual void copyGamepadState(gp_state* copy) { *copy = *this->getGamepadState(); }
+
+    // Move the axis changes seen since the previous call to samples,
+    // oldest first. Sources that only know the current state leave
+    // samples empty.
+    virtual void getAxisSamples(std::vector<gp_axis_sample>& samples) { samples.clear(); }
+};
+
+class GamepadHandler : public GamepadSource {
 public:
     GamepadHandler();
     ~GamepadHandler();
@@ -69,6 +134,11 @@ public:
     void startReading();
     gp_state* getGamepadState();
     bool IsActive();
+    void copyGamepadState(gp_state* copy);
+    void getAxisSamples(std::vector<gp_axis_sample>& samples);
+
+    // Apply to the reader thread, false if any setting was refused
+    bool setThreadOptions(const gp_thread_options& options);
 
 protected:
 
@@ -81,8 +151,30 @@ private:
     __u8 axes;
     __u8 buttons;
     char name[256];
-    bool reading;
+    std::atomic<bool> reading;  // cleared by the reader when the device fails
+    std::mutex stateLock;       // held by the reader while it changes gamepadState
+    std::mutex sampleLock;
+    std::vector<gp_axis_sample> samples;
+    EventClock eventClock;
+    std::atomic<pid_t> tid; // kernel id of the reader thread, for its nice value
+    void recordAxis(const gp_event* ev);
     static void* readEvents(void * obj);
 };
 
+// Fake device for testing without hardware: the sticks move along slow
+// sine waves and button 0 is pressed for one second every four seconds.
+// Axis samples are produced at 1 kHz.
+class SyntheticGamepad : public GamepadSource {
+public:
+    SyntheticGamepad(int axes = 8, int buttons = 12);
+    gp_state* getGamepadState();
+    bool IsActive();
+    void getAxisSamples(std::vector<gp_axis_sample>& samples);
+
+private:
+    gp_state state;
+    double start;
+    double lastSample;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,465 @@
+/*
+Gamepad state streaming over UDP
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "GamepadStream.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+
+static uint64_t realtimeMicroseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+// The clock of gp_axis_sample times
+static double monotonicSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// Tells processes apart, also several on one host
+static uint32_t processId()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint32_t)getpid() << 16) ^ (uint32_t)ts.tv_nsec;
+}
+
+static uint64_t joinTime(uint32_t hi, uint32_t lo)
+{
+    return ((uint64_t)ntohl(hi) << 32) | ntohl(lo);
+}
+
+// ----------------------------------------------------------------------------
+GamepadStreamSender::GamepadStreamSender() : fullInterval(0.25), packetsSent(0), sock(-1), session(processId()), sequence(0),
+                                             lastFull(0), lastChange(0)
+{
+    memset(&this->addr, 0, sizeof(this->addr));
+}
+
+GamepadStreamSender::~GamepadStreamSender()
+{
+    if (this->sock >= 0)
+        close(this->sock);
+}
+
+// ----------------------------------------------------------------------------
+bool GamepadStreamSender::Open(const char* host, int port)
+{
+    addrinfo hints, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(host, 0, &hints, &result) != 0)
+    {
+        std::cout << "WARNING: could not resolve " << host << std::endl;
+        return false;
+    }
+    this->addr = *(sockaddr_in*)result->ai_addr;
+    this->addr.sin_port = htons(port);
+    freeaddrinfo(result);
+
+    this->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (this->sock < 0)
+    {
+        std::cout << "WARNING: gamepad stream socket could not be created: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    std::cout << "Streaming gamepad to " << host << ":" << port << std::endl;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+void GamepadStreamSender::SendEntries(uint8_t type, const gp_stream_entry* entries, int count, uint64_t eventTime)
+{
+    gp_stream_entry out[GP_STREAM_MAX_ENTRIES];
+    for (int i = 0; i < count; i++)
+    {
+        out[i].type = entries[i].type;
+        out[i].number = entries[i].number;
+        out[i].value = htons(entries[i].value);
+    }
+    this->SendPacket(type, out, count*sizeof(gp_stream_entry), count, eventTime);
+}
+
+// Entries already in network byte order
+void GamepadStreamSender::SendPacket(uint8_t type, const void* entries, int bytes, int count, uint64_t eventTime)
+{
+    char buffer[sizeof(gp_stream_header) + GP_STREAM_MAX_ENTRIES*sizeof(gp_stream_sample)];
+    gp_stream_header* header = (gp_stream_header*)buffer;
+    uint64_t now = realtimeMicroseconds();
+
+    header->magic = htonl(GP_STREAM_MAGIC);
+    header->version = htons(GP_STREAM_VERSION);
+    header->type = type;
+    header->count = count;
+    header->sequence = htonl(++this->sequence);
+    header->session = htonl(this->session);
+    header->sendTimeHi = htonl(now >> 32);
+    header->sendTimeLo = htonl(now & 0xffffffff);
+    header->eventTimeHi = htonl(eventTime >> 32);
+    header->eventTimeLo = htonl(eventTime & 0xffffffff);
+
+    memcpy(buffer + sizeof(gp_stream_header), entries, bytes);
+
+    sendto(this->sock, buffer, sizeof(gp_stream_header) + bytes, 0, (sockaddr*)&this->addr, sizeof(this->addr));
+    this->packetsSent++;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Ages are taken right before the packets go out. A change older than
+// the 32 bit microsecond range is sent with the largest age.
+void GamepadStreamSender::SendSamples(const std::vector<gp_axis_sample>& samples)
+{
+    if (this->sock < 0 || samples.empty())
+        return;
+
+    double now = monotonicSeconds();
+    for (size_t i = 0; i < samples.size(); i += GP_STREAM_MAX_ENTRIES)
+    {
+        gp_stream_sample out[GP_STREAM_MAX_ENTRIES];
+        int count = std::min(samples.size() - i, (size_t)GP_STREAM_MAX_ENTRIES);
+        for (int j = 0; j < count; j++)
+        {
+            const gp_axis_sample& sample = samples[i + j];
+            double age = std::min(std::max(now - sample.time, 0.0)*1e6, 4294967295.0);
+            out[j].number = sample.number;
+            out[j].reserved = 0;
+            out[j].value = htons(sample.value);
+            out[j].age = htonl((uint32_t)age);
+        }
+        this->SendPacket(GP_STREAM_SAMPLES, out, count*sizeof(gp_stream_sample), count, this->lastChange);
+    }
+}
+
+// ----------------------------------------------------------------------------
+void GamepadStreamSender::Send(const gp_state* state)
+{
+    if (this->sock < 0)
+        return;
+
+    uint64_t now = realtimeMicroseconds();
+    bool resized = state->axis.size() != this->last.axis.size() ||
+                   state->button.size() != this->last.button.size();
+    bool full = resized || now - this->lastFull >= this->fullInterval*1e6;
+
+    std::vector<gp_stream_entry> changed, all;
+    for (size_t i = 0; i < state->axis.size() && i < 256; i++)
+    {
+        gp_stream_entry entry = { JS_EVENT_AXIS, (uint8_t)i, state->axis[i] };
+        all.push_back(entry);
+        if (resized || state->axis[i] != this->last.axis[i])
+            changed.push_back(entry);
+    }
+    for (size_t i = 0; i < state->button.size() && i < 256; i++)
+    {
+        gp_stream_entry entry = { JS_EVENT_BUTTON, (uint8_t)i, state->button[i] };
+        all.push_back(entry);
+        if (resized || state->button[i] != this->last.button[i])
+            changed.push_back(entry);
+    }
+
+    if (!changed.empty())
+        this->lastChange = now;
+
+    const std::vector<gp_stream_entry>& entries = full ? all : changed;
+    for (size_t i = 0; i < entries.size(); i += GP_STREAM_MAX_ENTRIES)
+    {
+        int count = std::min(entries.size() - i, (size_t)GP_STREAM_MAX_ENTRIES);
+        this->SendEntries(full ? GP_STREAM_FULL : GP_STREAM_DELTA, &entries[i], count, this->lastChange);
+    }
+
+    if (full)
+        this->lastFull = now;
+    this->last = *state;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Listen on the given UDP port and apply incoming state in a thread
+RemoteGamepad::RemoteGamepad(int port) : thread(0), sock(-1), reading(false), gamepadState(new gp_state()),
+    haveSequence(false), session(0), sequence(0), lastTransit(0), lastReceived(0), lastEventTime(0), changePending(false),
+    latencySamples(0)
+{
+    memset(&this->stats, 0, sizeof(this->stats));
+    pthread_mutex_init(&this->statsLock, 0);
+
+    // Same minimum size as GamepadHandler, the style reads fixed numbers
+    this->gamepadState->axis.resize(8, 0);
+    this->gamepadState->button.resize(12, 0);
+
+    this->sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (this->sock < 0 || bind(this->sock, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        std::cout << "WARNING: could not listen for gamepad stream on port " << port << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    // Wake up regularly to notice a stopped stream and to exit
+    timeval timeout = { 0, 100000 };
+    setsockopt(this->sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::cout << "Listening for gamepad stream on port " << port << std::endl;
+    this->reading = true;
+    pthread_create(&(this->thread), 0, &RemoteGamepad::receive, this);
+}
+
+RemoteGamepad::~RemoteGamepad()
+{
+    if (this->reading)
+    {
+        this->reading = false;
+        pthread_join(this->thread, 0);
+
+        gp_stream_stats s = this->getStats();
+        std::cout << "Gamepad stream: " << s.packets << " packets, " << s.lost << " lost, " << s.late << " late, "
+                  << "jitter " << s.jitter << " ms, latency " << s.latencyMean << " ms (max " << s.latencyMax << " ms)" << std::endl;
+    }
+    if (this->sock >= 0)
+        close(this->sock);
+    pthread_mutex_destroy(&this->statsLock);
+    delete this->gamepadState;
+}
+
+// ----------------------------------------------------------------------------
+void* RemoteGamepad::receive(void* obj)
+{
+    RemoteGamepad* gp = reinterpret_cast<RemoteGamepad*>(obj);
+    char buffer[2048];
+
+    while (gp->reading)
+    {
+        ssize_t bytes = recv(gp->sock, buffer, sizeof(buffer), 0);
+        if (bytes > 0)
+        {
+            gp->Apply(buffer, bytes);
+            continue;
+        }
+
+        // Link silent for a second: let go of everything
+        if (gp->lastReceived != 0 && realtimeMicroseconds() - gp->lastReceived > 1000000)
+        {
+            gp->Neutral();
+            gp->lastReceived = 0;
+        }
+    }
+
+    return 0;
+}
+
+// Centered axes are recorded as changes too, so the style's integration
+// sees the sticks let go
+void RemoteGamepad::Neutral()
+{
+    double now = monotonicSeconds();
+    std::lock_guard<std::mutex> guard(this->stateLock);
+    for (size_t i = 0; i < this->gamepadState->axis.size(); i++)
+    {
+        if (this->gamepadState->axis[i] == 0)
+            continue;
+        gp_axis_sample sample = { now, now, (unsigned char)i, 0 };
+        if (this->samples.size() < 4096)
+            this->samples.push_back(sample);
+        this->gamepadState->axis[i] = 0;
+    }
+    std::fill(this->gamepadState->button.begin(), this->gamepadState->button.end(), 0);
+}
+
+// ----------------------------------------------------------------------------
+void RemoteGamepad::Apply(const char* data, int bytes)
+{
+    if (bytes < (int)sizeof(gp_stream_header))
+        return;
+
+    const gp_stream_header* header = (const gp_stream_header*)data;
+    size_t entrySize = header->type == GP_STREAM_SAMPLES ? sizeof(gp_stream_sample) : sizeof(gp_stream_entry);
+    if (ntohl(header->magic) != GP_STREAM_MAGIC || ntohs(header->version) != GP_STREAM_VERSION ||
+        bytes != (int)(sizeof(gp_stream_header) + header->count*entrySize))
+        return;
+
+    uint64_t now = realtimeMicroseconds();
+    uint32_t sequence = ntohl(header->sequence);
+    uint32_t session = ntohl(header->session);
+
+    pthread_mutex_lock(&this->statsLock);
+
+    // A restarted sender counts from 1 again
+    bool newSession = !this->haveSequence || session != this->session;
+    if (newSession)
+    {
+        this->stats.sessions++;
+        this->session = session;
+    }
+    else
+    {
+        int32_t gap = (int32_t)(sequence - this->sequence);
+        if (gap <= 0)
+        {
+            this->stats.late++;
+            pthread_mutex_unlock(&this->statsLock);
+            return;
+        }
+        this->stats.lost += gap - 1;
+    }
+    this->haveSequence = true;
+    this->sequence = sequence;
+    this->lastReceived = now;
+    this->stats.packets++;
+
+    // Interarrival jitter as in RFC 3550, the constant clock offset
+    // between the hosts cancels out
+    double transit = (double)(int64_t)(now - joinTime(header->sendTimeHi, header->sendTimeLo))/1000;
+    if (!newSession)
+        this->stats.jitter += (fabs(transit - this->lastTransit) - this->stats.jitter)/16;
+    this->lastTransit = transit;
+
+    if (header->type == GP_STREAM_FULL)
+        this->stats.fullStates++;
+
+    // Full states repeat the time of the last change, only a new change
+    // is timed, when getGamepadState() hands it out. Samples go out
+    // before the state that times them.
+    uint64_t eventTime = joinTime(header->eventTimeHi, header->eventTimeLo);
+    if (header->type != GP_STREAM_SAMPLES && eventTime != this->lastEventTime)
+    {
+        this->lastEventTime = eventTime;
+        this->changePending = true;
+    }
+
+    pthread_mutex_unlock(&this->statsLock);
+
+    if (header->type == GP_STREAM_SAMPLES)
+    {
+        this->ApplySamples((const gp_stream_sample*)(data + sizeof(gp_stream_header)), header->count);
+        return;
+    }
+
+    const gp_stream_entry* entries = (const gp_stream_entry*)(data + sizeof(gp_stream_header));
+    std::lock_guard<std::mutex> guard(this->stateLock);
+    for (int i = 0; i < header->count; i++)
+    {
+        signed short value = (signed short)ntohs(entries[i].value);
+        if (entries[i].type == JS_EVENT_AXIS && entries[i].number < this->gamepadState->axis.size())
+            this->gamepadState->axis[entries[i].number] = value;
+        else if (entries[i].type == JS_EVENT_BUTTON && entries[i].number < this->gamepadState->button.size())
+            this->gamepadState->button[entries[i].number] = value;
+    }
+}
+
+// Forwarded changes also update the state, a lost state packet then does
+// not leave it behind the samples
+void RemoteGamepad::ApplySamples(const gp_stream_sample* entries, int count)
+{
+    double now = monotonicSeconds();
+    std::lock_guard<std::mutex> guard(this->stateLock);
+    for (int i = 0; i < count; i++)
+    {
+        if (entries[i].number >= this->gamepadState->axis.size())
+            continue;
+        gp_axis_sample sample;
+        sample.time = now - ntohl(entries[i].age)/1e6;
+        sample.delivered = now;
+        sample.number = entries[i].number;
+        sample.value = (signed short)ntohs(entries[i].value);
+        if (this->samples.size() < 4096)
+            this->samples.push_back(sample);
+        this->gamepadState->axis[sample.number] = sample.value;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Called by the interactor style when it applies the input, which is
+// where the latency statistic ends
+gp_state* RemoteGamepad::getGamepadState()
+{
+    pthread_mutex_lock(&this->statsLock);
+    if (this->changePending)
+    {
+        double latency = (double)(int64_t)(realtimeMicroseconds() - this->lastEventTime)/1000;
+        this->latencySamples++;
+        this->stats.latencyMean += (latency - this->stats.latencyMean)/this->latencySamples;
+        this->stats.latencyMax = std::max(this->stats.latencyMax, latency);
+        this->changePending = false;
+    }
+    pthread_mutex_unlock(&this->statsLock);
+
+    return this->gamepadState;
+}
+
+bool RemoteGamepad::IsActive()
+{
+    return this->reading;
+}
+
+void RemoteGamepad::copyGamepadState(gp_state* copy)
+{
+    std::lock_guard<std::mutex> guard(this->stateLock);
+    *copy = *this->gamepadState;
+}
+
+void RemoteGamepad::getAxisSamples(std::vector<gp_axis_sample>& samples)
+{
+    std::lock_guard<std::mutex> guard(this->stateLock);
+    samples.swap(this->samples);
+    this->samples.clear();
+}
+
+gp_stream_stats RemoteGamepad::getStats()
+{
+    pthread_mutex_lock(&this->statsLock);
+    gp_stream_stats s = this->stats;
+    pthread_mutex_unlock(&this->statsLock);
+    return s;
+}
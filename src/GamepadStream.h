@@ -0,0 +1,168 @@
+#ifndef __GAMEPADSTREAM_H__
+#define __GAMEPADSTREAM_H__
+
+/*
+Gamepad state streaming over UDP
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "GamepadHandler.h"
+#include <netinet/in.h>
+#include <stdint.h>
+
+#define GP_STREAM_MAGIC     0x47505354  /* "GPST" */
+#define GP_STREAM_VERSION   3
+#define GP_STREAM_FULL      1   /* complete state, sent periodically */
+#define GP_STREAM_DELTA     2   /* only the entries that changed */
+#define GP_STREAM_SAMPLES   3   /* axis changes, gp_stream_sample entries */
+#define GP_STREAM_MAX_ENTRIES 64
+
+// Packet layout, all fields in network byte order. Times are
+// CLOCK_REALTIME microseconds split in two words, so end-to-end latency
+// is only meaningful between hosts with synchronized clocks (or on
+// loopback). Sequence numbers count per session, a restarted sender
+// starts a new session from 1.
+struct gp_stream_header {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t type;
+    uint8_t count;          /* number of entries that follow */
+    uint32_t sequence;
+    uint32_t session;       /* random id of the sending process */
+    uint32_t sendTimeHi, sendTimeLo;
+    uint32_t eventTimeHi, eventTimeLo;  /* when the newest change was read */
+};
+
+struct gp_stream_entry {
+    uint8_t type;           /* JS_EVENT_BUTTON or JS_EVENT_AXIS */
+    uint8_t number;
+    int16_t value;
+};
+
+// One axis change as the sender's device reported it. The age is taken
+// against the send time on the sender's clock and the receive time on
+// the receiver's, so no clock synchronization is needed; the changes
+// arrive shifted by the network delay but keep their spacing.
+struct gp_stream_sample {
+    uint8_t number;         /* axis */
+    uint8_t reserved;
+    int16_t value;
+    uint32_t age;           /* microseconds from the change to sending */
+};
+
+struct gp_stream_stats {
+    uint64_t packets;       /* accepted packets */
+    uint64_t lost;          /* gaps in the sequence numbers */
+    uint64_t late;          /* reordered packets that were dropped */
+    uint64_t fullStates;
+    uint64_t sessions;      /* sender (re)starts seen */
+    double jitter;          /* RFC 3550 interarrival jitter, ms */
+    double latencyMean;     /* read on the sender to taken by getGamepadState(), ms */
+    double latencyMax;
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Sender side, used by the gamepadforward daemon. Every call to Send()
+// transmits the entries that changed since the previous call; the full
+// state goes out every fullInterval seconds so a receiver recovers from
+// lost packets. SendSamples() forwards the axis changes the source
+// recorded (GamepadSource::getAxisSamples()), call it before Send() so
+// the receiver gets the changes before the state they led to.
+class GamepadStreamSender {
+public:
+    GamepadStreamSender();
+    ~GamepadStreamSender();
+    bool Open(const char* host, int port);
+    void Send(const gp_state* state);
+    void SendSamples(const std::vector<gp_axis_sample>& samples);
+
+    double fullInterval;
+    uint64_t packetsSent;
+
+private:
+    void SendEntries(uint8_t type, const gp_stream_entry* entries, int count, uint64_t eventTime);
+    void SendPacket(uint8_t type, const void* entries, int bytes, int count, uint64_t eventTime);
+
+    int sock;
+    sockaddr_in addr;
+    uint32_t session;
+    uint32_t sequence;
+    gp_state last;
+    uint64_t lastFull;
+    uint64_t lastChange;
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Receiver side: a gamepad source fed from the network instead of a
+// local device. When nothing arrives for a second the state is reset to
+// neutral, so a dropped link cannot leave the camera moving. Packets from
+// a new sender session are always taken, so a restarted daemon is picked
+// up right away. Forwarded axis changes are handed out by
+// getAxisSamples() with times on the local CLOCK_MONOTONIC, like those of
+// a local device.
+class RemoteGamepad : public GamepadSource {
+public:
+    RemoteGamepad(int port);
+    ~RemoteGamepad();
+    gp_state* getGamepadState();
+    bool IsActive();
+    void copyGamepadState(gp_state* copy);
+    void getAxisSamples(std::vector<gp_axis_sample>& samples);
+    gp_stream_stats getStats();
+
+private:
+    static void* receive(void* obj);
+    void Apply(const char* data, int bytes);
+    void ApplySamples(const gp_stream_sample* entries, int count);
+    void Neutral();
+
+    pthread_t thread;
+    pthread_mutex_t statsLock;
+    int sock;
+    std::atomic<bool> reading;
+    gp_state* gamepadState;
+    std::mutex stateLock;       // held while gamepadState or samples change
+    std::vector<gp_axis_sample> samples;
+    gp_stream_stats stats;
+    bool haveSequence;
+    uint32_t session;
+    uint32_t sequence;
+    double lastTransit;
+    uint64_t lastReceived;
+    uint64_t lastEventTime;     // newest change received
+    bool changePending;         // not taken by getGamepadState() yet
+    uint64_t latencySamples;
+};
+
+#endif
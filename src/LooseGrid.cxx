@@ -0,0 +1,421 @@
+/*
+Loose grid of bounding boxes for frustum culling
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "LooseGrid.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+enum cell_state { CELL_OUTSIDE, CELL_PARTIAL, CELL_INSIDE };
+
+static int64_t cellKey(const double* bounds, double size)
+{
+    int64_t key = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        int64_t i = (int64_t)floor(0.5*(bounds[2*k] + bounds[2*k+1])/size);
+        key = (key << 21) | (i & 0x1fffff);
+    }
+    return key;
+}
+
+// Classify a box against inward facing planes. slack is how far the
+// planes can move before the classification may change.
+static int classify(const double* planes, const double* bounds, double* slack)
+{
+    bool partial = false;
+    double inside = DBL_MAX, outside = 0.0;
+    for (int i = 0; i < 6; i++)
+    {
+        const double* p = planes + 4*i;
+        double nearest = p[3], farthest = p[3];
+        for (int k = 0; k < 3; k++)
+        {
+            nearest += p[k]*(p[k] > 0 ? bounds[2*k] : bounds[2*k+1]);
+            farthest += p[k]*(p[k] > 0 ? bounds[2*k+1] : bounds[2*k]);
+        }
+        if (farthest < 0)
+            outside = std::max(outside, -farthest);
+        else if (nearest < 0)
+            partial = true;
+        else
+            inside = std::min(inside, nearest);
+    }
+
+    if (outside > 0)
+    {
+        *slack = outside;
+        return CELL_OUTSIDE;
+    }
+    *slack = partial ? 0.0 : inside;
+    return partial ? CELL_PARTIAL : CELL_INSIDE;
+}
+
+static double farthestCorner(const double* p, const double* bounds)
+{
+    double d2 = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        double d = std::max(fabs(bounds[2*k] - p[k]), fabs(bounds[2*k+1] - p[k]));
+        d2 += d*d;
+    }
+    return sqrt(d2);
+}
+
+static double distance(const double* a, const double* b)
+{
+    return sqrt((a[0] - b[0])*(a[0] - b[0]) + (a[1] - b[1])*(a[1] - b[1]) + (a[2] - b[2])*(a[2] - b[2]));
+}
+
+// ----------------------------------------------------------------------------
+LooseGrid::LooseGrid(double cellSize) : cellSize(cellSize), frame(0), touched(0), valid(false), travel(0), turn(0),
+    clip(0), cellsTested(0), boxesTested(0)
+{
+}
+
+size_t LooseGrid::GetDeadlineCount() const
+{
+    return this->deadlines[0].size() + this->deadlines[1].size() + this->deadlines[2].size();
+}
+
+void LooseGrid::BeginFrame()
+{
+    this->frame++;
+    this->touched = 0;
+}
+
+// ----------------------------------------------------------------------------
+int LooseGrid::Touch(const void* item, unsigned long time, bool* stale)
+{
+    int id;
+    bool added = false;
+    std::unordered_map<const void*, int>::iterator it = this->recordIndex.find(item);
+    if (it != this->recordIndex.end())
+        id = it->second;
+    else
+    {
+        added = true;
+        if (this->freeRecords.empty())
+        {
+            id = (int)this->records.size();
+            this->records.push_back(record());
+        }
+        else
+        {
+            id = this->freeRecords.back();
+            this->freeRecords.pop_back();
+        }
+        record& r = this->records[id];
+        r.item = item;
+        r.time = 0;
+        r.cell = -1;
+        r.bounded = false;
+        r.visible = true;
+        this->recordIndex[item] = id;
+    }
+
+    record& r = this->records[id];
+    if (r.seen != this->frame)
+        this->touched++;
+    r.seen = this->frame;
+    *stale = added || time != r.time;
+    r.time = time;
+    return id;
+}
+
+void LooseGrid::SetBounds(int id, const double* bounds)
+{
+    record& r = this->records[id];
+    this->RemoveFromCell(id);
+    r.bounded = bounds != NULL && bounds[0] <= bounds[1];
+    r.visible = true;
+    if (r.bounded)
+    {
+        std::copy(bounds, bounds + 6, r.bounds);
+        this->AddToCell(id);
+    }
+}
+
+bool LooseGrid::IsVisible(int id) const
+{
+    const record& r = this->records[id];
+    return !r.bounded || r.visible;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Record the camera motion since the last call. Anything but a change of
+// pose and clipping range changes the frustum's shape, after that all
+// cells are tested again.
+bool LooseGrid::UpdateMotion(const grid_view& view)
+{
+    const grid_view& last = this->last;
+    bool same = this->valid && last.viewAngle == view.viewAngle && last.aspect == view.aspect &&
+        last.parallel == view.parallel && last.parallelScale == view.parallelScale &&
+        last.windowCenter[0] == view.windowCenter[0] && last.windowCenter[1] == view.windowCenter[1];
+
+    if (same)
+    {
+        this->travel += distance(view.position, last.position);
+        this->turn += 2*(distance(view.direction, last.direction) + distance(view.viewUp, last.viewUp));
+        this->clip += fabs(view.clippingRange[0] - last.clippingRange[0]) +
+            fabs(view.clippingRange[1] - last.clippingRange[1]);
+    }
+
+    this->last = view;
+    this->valid = true;
+    return same;
+}
+
+// ----------------------------------------------------------------------------
+void LooseGrid::RemoveFromCell(int id)
+{
+    record& r = this->records[id];
+    if (r.cell < 0)
+        return;
+    cell& c = this->cells[r.cell];
+    int last = c.members.back();
+    c.members[r.slot] = last;
+    this->records[last].slot = r.slot;
+    c.members.pop_back();
+    if (!c.dirty)
+        this->dirtyCells.push_back(r.cell);
+    c.dirty = true;
+    r.cell = -1;
+}
+
+void LooseGrid::AddToCell(int id)
+{
+    record& r = this->records[id];
+    int64_t key = cellKey(r.bounds, this->cellSize);
+    std::unordered_map<int64_t, int>::iterator it = this->cellIndex.find(key);
+    if (it == this->cellIndex.end())
+    {
+        cell c;
+        c.dirty = false;
+        c.state = CELL_OUTSIDE;
+        c.slack = c.radius = c.travel = c.turn = c.clip = 0;
+        c.stamp = 0;
+        c.visit = 0;
+        this->cells.push_back(c);
+        it = this->cellIndex.insert(std::make_pair(key, (int)this->cells.size() - 1)).first;
+    }
+    cell& c = this->cells[it->second];
+    r.cell = it->second;
+    r.slot = (int)c.members.size();
+    c.members.push_back(id);
+    if (!c.dirty)
+        this->dirtyCells.push_back(r.cell);
+    c.dirty = true;
+}
+
+// Forget items that were not touched this frame
+void LooseGrid::Sweep()
+{
+    for (size_t id = 0; id < this->records.size(); id++)
+    {
+        record& r = this->records[id];
+        if (r.item == NULL || r.seen == this->frame)
+            continue;
+        this->RemoveFromCell(id);
+        this->recordIndex.erase(r.item);
+        r.item = NULL;
+        this->freeRecords.push_back(id);
+    }
+}
+
+// ----------------------------------------------------------------------------
+void LooseGrid::AddToWorklist(int c)
+{
+    if (this->cells[c].visit == this->frame)
+        return;
+    this->cells[c].visit = this->frame;
+    this->worklist.push_back(c);
+}
+
+// Move the cells whose deadline on accumulator a passed to the worklist
+void LooseGrid::Expire(int a, double now)
+{
+    std::vector<deadline>& heap = this->deadlines[a];
+    while (!heap.empty() && heap.front().value <= now)
+    {
+        deadline d = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), Later);
+        heap.pop_back();
+        if (d.stamp == this->cells[d.cell].stamp)
+            this->AddToWorklist(d.cell);
+    }
+}
+
+// Stale deadlines are only dropped when they come up, rebuild the heaps
+// when they pile up
+void LooseGrid::CompactDeadlines()
+{
+    for (int a = 0; a < 3; a++)
+    {
+        std::vector<deadline>& heap = this->deadlines[a];
+        if (heap.size() < 4*this->cells.size() + 64)
+            continue;
+        size_t kept = 0;
+        for (size_t i = 0; i < heap.size(); i++)
+            if (heap[i].stamp == this->cells[heap[i].cell].stamp)
+                heap[kept++] = heap[i];
+        heap.resize(kept);
+        std::make_heap(heap.begin(), heap.end(), Later);
+    }
+}
+
+// Description:
+// A cell tested at accumulators (travel, turn, clip) may change state
+// once the frustum planes moved by its slack s, that is (see Classify)
+// once
+//   dtravel + dturn*(radius + dtravel) + dclip >= s.
+// Splitting s in three gives a deadline per accumulator that keeps the
+// sum below s while none of them has passed: dtravel < s/3,
+// dclip < s/3 and dturn < (s/3)/(radius + s/3).
+void LooseGrid::Schedule(int c)
+{
+    cell& tested = this->cells[c];
+    double third = tested.slack/3;
+    deadline d[3];
+    d[0].value = tested.travel + third;
+    d[1].value = tested.turn + third/(tested.radius + third + 1e-300);
+    d[2].value = tested.clip + third;
+    for (int a = 0; a < 3; a++)
+    {
+        d[a].cell = c;
+        d[a].stamp = tested.stamp;
+        this->deadlines[a].push_back(d[a]);
+        std::push_heap(this->deadlines[a].begin(), this->deadlines[a].end(), Later);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// A cell is tested again when it changed, when it straddles the frustum
+// or when the camera could have moved a frustum plane by its slack: a
+// plane through the camera moves by at most the camera's path length
+// plus its rotation times the distance, the near and far planes also by
+// their own change. Only those cells are visited.
+void LooseGrid::Classify(const grid_view& view)
+{
+    this->cellsTested = 0;
+    this->boxesTested = 0;
+    bool coherent = this->UpdateMotion(view);
+
+    if (this->recordIndex.size() > this->touched)
+        this->Sweep();
+
+    this->worklist.clear();
+    if (!coherent)
+    {
+        // The frustum changed shape, every deadline is void
+        for (int a = 0; a < 3; a++)
+            this->deadlines[a].clear();
+        for (size_t c = 0; c < this->cells.size(); c++)
+            this->AddToWorklist((int)c);
+    }
+    else
+    {
+        for (size_t i = 0; i < this->dirtyCells.size(); i++)
+            this->AddToWorklist(this->dirtyCells[i]);
+        for (size_t i = 0; i < this->partialCells.size(); i++)
+            this->AddToWorklist(this->partialCells[i]);
+        this->Expire(0, this->travel);
+        this->Expire(1, this->turn);
+        this->Expire(2, this->clip);
+    }
+    this->dirtyCells.clear();
+    this->partialCells.clear();
+
+    for (size_t w = 0; w < this->worklist.size(); w++)
+    {
+        int c = this->worklist[w];
+        cell& tested = this->cells[c];
+        tested.stamp++;
+        if (tested.members.empty())
+        {
+            tested.dirty = false;
+            continue;
+        }
+
+        if (tested.dirty)
+        {
+            const double* first = this->records[tested.members[0]].bounds;
+            std::copy(first, first + 6, tested.bounds);
+            for (size_t m = 1; m < tested.members.size(); m++)
+            {
+                const double* b = this->records[tested.members[m]].bounds;
+                for (int k = 0; k < 3; k++)
+                {
+                    tested.bounds[2*k] = std::min(tested.bounds[2*k], b[2*k]);
+                    tested.bounds[2*k+1] = std::max(tested.bounds[2*k+1], b[2*k+1]);
+                }
+            }
+        }
+
+        int state = classify(view.planes, tested.bounds, &tested.slack);
+        tested.radius = farthestCorner(view.position, tested.bounds);
+        tested.travel = this->travel;
+        tested.turn = this->turn;
+        tested.clip = this->clip;
+        this->cellsTested++;
+
+        // Members only need their flags set when the cell's state changed,
+        // only a straddling cell tests its boxes
+        if (state != tested.state || tested.dirty || state == CELL_PARTIAL)
+        {
+            for (size_t m = 0; m < tested.members.size(); m++)
+            {
+                record& r = this->records[tested.members[m]];
+                if (state == CELL_PARTIAL)
+                {
+                    double slack;
+                    r.visible = classify(view.planes, r.bounds, &slack) != CELL_OUTSIDE;
+                    this->boxesTested++;
+                }
+                else
+                    r.visible = state == CELL_INSIDE;
+            }
+        }
+        tested.state = state;
+        tested.dirty = false;
+
+        if (state == CELL_PARTIAL)
+            this->partialCells.push_back(c);
+        else
+            this->Schedule(c);
+    }
+    this->CompactDeadlines();
+}
@@ -0,0 +1,167 @@
+#ifndef __LOOSEGRID_H__
+#define __LOOSEGRID_H__
+
+/*
+Loose grid of bounding boxes for frustum culling
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+// The camera a frame is culled for. The planes face inward and have unit
+// normals; the rest tells motion of the frustum from a change of its
+// shape.
+struct grid_view {
+    double planes[24];
+    double position[3], direction[3], viewUp[3], clippingRange[2];
+    double viewAngle, parallelScale, aspect, windowCenter[2];
+    int parallel;
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Frustum culling state kept between frames, the part of
+// vtkLooseGridCuller that does not need VTK. Boxes are binned by their
+// center into a uniform grid of cellSize, each cell keeps the union of
+// its boxes. Per frame only cells the camera motion since their last
+// test could have moved across a frustum plane are tested again, found
+// through lists of changed and straddling cells and heaps of deadlines
+// on the accumulated motion; the boxes of a cell are tested one by one
+// only while the cell straddles the frustum boundary.
+//
+// A frame is BeginFrame(), Touch() for every item in the list (with
+// SetBounds() when Touch() reports the item stale), then Classify().
+// Items not touched in a frame are forgotten.
+class LooseGrid {
+public:
+    LooseGrid(double cellSize);
+
+    double GetCellSize() const { return this->cellSize; }
+
+    void BeginFrame();
+
+    // Record of item for this frame. stale is set for a new item and when
+    // time differs from the time its bounds are from, SetBounds() must
+    // follow then.
+    int Touch(const void* item, unsigned long time, bool* stale);
+
+    // Bounds of a record, NULL or empty bounds are never culled
+    void SetBounds(int id, const double* bounds);
+
+    // Test the cells that may have changed against view
+    void Classify(const grid_view& view);
+
+    // Outcome of the last Classify() for a record
+    bool IsVisible(int id) const;
+
+    // Work done by the last Classify()
+    int GetCellsTested() const { return this->cellsTested; }
+    int GetBoxesTested() const { return this->boxesTested; }
+
+    // Size of the grid: cells and pending deadlines, stale ones included
+    size_t GetCellCount() const { return this->cells.size(); }
+    size_t GetDeadlineCount() const;
+
+private:
+    struct record {
+        const void* item;
+        double bounds[6];
+        bool bounded;               // items without bounds are never culled
+        unsigned long time;         // the bounds are from
+        int cell;                   // -1 when unbounded
+        int slot;                   // position in the cell's members
+        unsigned long seen;         // frame the item was last touched
+        bool visible;
+    };
+
+    struct cell {
+        std::vector<int> members;
+        double bounds[6];           // union of the members' bounds
+        bool dirty;                 // membership or member bounds changed
+        int state;
+        double slack;               // distance the frustum may move before the state can change
+        double radius;              // farthest corner from the camera at the test
+        double travel, turn, clip;  // motion accumulators at the test
+        unsigned stamp;             // number of tests, older deadlines are stale
+        unsigned long visit;        // frame the cell was last put on the worklist
+    };
+
+    // When the motion accumulator reaches deadline the cell may have
+    // changed state. Each accumulator has a heap of its own.
+    struct deadline {
+        double value;
+        int cell;
+        unsigned stamp;
+    };
+
+    static bool Later(const deadline& a, const deadline& b) { return a.value > b.value; }
+
+    bool UpdateMotion(const grid_view& view);
+    void RemoveFromCell(int id);
+    void AddToCell(int id);
+    void Sweep();
+    void AddToWorklist(int c);
+    void Expire(int a, double now);
+    void CompactDeadlines();
+    void Schedule(int c);
+
+    double cellSize;
+    unsigned long frame;
+    size_t touched;                 // records touched this frame
+    std::vector<record> records;
+    std::vector<int> freeRecords;
+    std::unordered_map<const void*, int> recordIndex;
+    std::vector<cell> cells;
+    std::unordered_map<int64_t, int> cellIndex;
+
+    // Cells to test this frame: changed cells, straddling cells and cells
+    // whose deadline on the travel, turn or clip accumulator passed
+    std::vector<int> dirtyCells;
+    std::vector<int> partialCells;
+    std::vector<int> worklist;
+    std::vector<deadline> deadlines[3];
+
+    // View at the previous Classify() and the motion accumulated since
+    // the grid was built: path length, rotation (chord length of the view
+    // direction plus view up) and near/far plane movement
+    bool valid;
+    grid_view last;
+    double travel, turn, clip;
+
+    int cellsTested;
+    int boxesTested;
+};
+
+#endif
@@ -0,0 +1,483 @@
+/*
+Render-free camera navigation integrator
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "NavigationIntegrator.h"
+#include "AxisIntegrator.h"
+
+#include <algorithm>
+#include <math.h>
+
+// Vector helpers with the same results as their vtkMath counterparts
+static void cross(const double* a, const double* b, double* c)
+{
+    double x = a[1]*b[2] - a[2]*b[1];
+    double y = a[2]*b[0] - a[0]*b[2];
+    double z = a[0]*b[1] - a[1]*b[0];
+    c[0] = x; c[1] = y; c[2] = z;
+}
+
+static double dot(const double* a, const double* b)
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static double norm(const double* v)
+{
+    return sqrt(dot(v, v));
+}
+
+static double normalize(double* v)
+{
+    double length = norm(v);
+    if (length != 0.0)
+        for (int i = 0; i < 3; i++)
+            v[i] /= length;
+    return length;
+}
+
+// Rotate v by angle degrees around the unit vector axis (right handed,
+// like vtkTransform::RotateWXYZ)
+static void rotateVector(double* v, const double* axis, double angle)
+{
+    double a = angle * M_PI / 180.0;
+    double c = cos(a), s = sin(a);
+    double w[3];
+    cross(axis, v, w);
+    double d = dot(axis, v) * (1 - c);
+    for (int i = 0; i < 3; i++)
+        v[i] = v[i]*c + w[i]*s + axis[i]*d;
+}
+
+static void directionOfProjection(const nav_pose* pose, double* dir)
+{
+    for (int i = 0; i < 3; i++)
+        dir[i] = pose->focalPoint[i] - pose->position[i];
+    normalize(dir);
+}
+
+// Same result as vtkCamera::OrthogonalizeViewUp()
+static void orthogonalizeViewUp(nav_pose* pose)
+{
+    double dir[3];
+    directionOfProjection(pose, dir);
+    double d = dot(pose->viewUp, dir);
+    for (int i = 0; i < 3; i++)
+        pose->viewUp[i] -= d*dir[i];
+    normalize(pose->viewUp);
+}
+
+static void translate(nav_pose* pose, const double* motion)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        pose->position[i] += motion[i];
+        pose->focalPoint[i] += motion[i];
+    }
+}
+
+// vtkCamera::Yaw(): rotate the focal point around the view up through
+// the position
+static void yaw(nav_pose* pose, const double* axis, double angle)
+{
+    double v[3];
+    for (int i = 0; i < 3; i++)
+        v[i] = pose->focalPoint[i] - pose->position[i];
+    rotateVector(v, axis, angle);
+    for (int i = 0; i < 3; i++)
+        pose->focalPoint[i] = pose->position[i] + v[i];
+}
+
+static double clampSpeed(double speed, double maxSpeed)
+{
+    return speed > maxSpeed ? maxSpeed : speed < -maxSpeed ? -maxSpeed : speed;
+}
+
+// ----------------------------------------------------------------------------
+NavigationIntegrator::NavigationIntegrator() : maxSpeed(1), gamepadLookSpeed(20), turntableMode(false), flying(false), flyto(0),
+                                               deadzone(0), responseExponent(1), keyboardRoll(0), mouseYaw(0), speedScale(1),
+                                               modeButtonDown(false), keys(0)
+{
+    for (int i = 0; i < 3; i++)
+        this->flyDestination[i] = this->flyFocus[i] = 0;
+    for (int i = 0; i < 2; i++)
+        this->keyboardSpeed[i] = this->gamepadSpeed[i] = this->look[i] = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Repeated presses of a held key change nothing, except for the max
+// speed keys, which step on every press
+int NavigationIntegrator::HandleKey(int key, bool down)
+{
+    double oldKeyboardSpeedX = this->keyboardSpeed[0];
+    double oldKeyboardSpeedY = this->keyboardSpeed[1];
+    double oldKeyboardRoll = this->keyboardRoll;
+    double oldMaxSpeed = this->maxSpeed;
+
+    switch (key)
+    {
+    case NAV_KEY_W: this->keyboardSpeed[1] = down ? this->maxSpeed : 0.0; break;
+    case NAV_KEY_A: this->keyboardSpeed[0] = down ? -this->maxSpeed : 0.0; break;
+    case NAV_KEY_S: this->keyboardSpeed[1] = down ? -this->maxSpeed : 0.0; break;
+    case NAV_KEY_D: this->keyboardSpeed[0] = down ? this->maxSpeed : 0.0; break;
+    case NAV_KEY_Q: this->keyboardRoll = down ? this->gamepadLookSpeed : 0.0; break;
+    case NAV_KEY_E: this->keyboardRoll = down ? -this->gamepadLookSpeed : 0.0; break;
+    case NAV_KEY_BRACKETLEFT:
+        if (down)
+            this->maxSpeed = std::max(this->maxSpeed - 1, 0.0);
+        break;
+    case NAV_KEY_BRACKETRIGHT:
+        if (down)
+            this->maxSpeed = std::min(this->maxSpeed + 1, 200.0);
+        break;
+    }
+
+    int events = 0;
+    if (this->keyboardSpeed[0] != oldKeyboardSpeedX || this->keyboardSpeed[1] != oldKeyboardSpeedY ||
+        this->keyboardRoll != oldKeyboardRoll)
+        events |= NAV_KEYS_CHANGED;
+    if (this->maxSpeed != oldMaxSpeed)
+        events |= NAV_SPEED_CHANGED;
+    return events;
+}
+
+// ----------------------------------------------------------------------------
+int NavigationIntegrator::HandleGamepad(const double* sticks, const double* dpad, int buttons)
+{
+    int events = 0;
+
+    // Button 9: mode switch
+    if (buttons & (1 << 8))
+    {
+        if (!this->modeButtonDown)
+        {
+            this->turntableMode = !this->turntableMode;
+            this->modeButtonDown = true;
+            events |= NAV_MODE_CHANGED;
+        }
+    }
+    else
+        this->modeButtonDown = false;
+
+    // Left analog stick: movement
+    this->gamepadSpeed[0] = sticks[0]*this->maxSpeed;
+    this->gamepadSpeed[1] = -sticks[1]*this->maxSpeed;
+
+    // Turntable mode leaves the look speed of the last game mode state
+    if (!this->turntableMode)
+    {
+        int target = 0;
+        for (int i = 0; i < 4; i++)
+            if (buttons & (1 << i))
+                target = i + 1;
+        if (target != 0)
+            events |= this->StartFlight(target);
+
+        // Right analog stick: looking speed
+        this->look[0] = -sticks[2];
+        this->look[1] = -sticks[3];
+
+        // The d-pad overrides the left stick
+        if (dpad[0] != 0)
+            this->gamepadSpeed[0] = dpad[1]/32767*this->maxSpeed;
+        else if (dpad[1] != 0)
+            this->gamepadSpeed[0] = -dpad[2]/32767*this->maxSpeed;
+    }
+    return events;
+}
+
+// ----------------------------------------------------------------------------
+int NavigationIntegrator::ApplySample(const double* sample)
+{
+    int events = 0;
+    int keys = (int)sample[NAV_KEYS];
+    int changed = keys ^ this->keys;
+    for (int key = NAV_KEY_W; key <= NAV_KEY_BRACKETRIGHT; key <<= 1)
+        if ((changed & key) && !(keys & key))
+            events |= this->HandleKey(key, false);
+    for (int key = NAV_KEY_W; key <= NAV_KEY_BRACKETRIGHT; key <<= 1)
+        if ((changed & key) && (keys & key))
+            events |= this->HandleKey(key, true);
+    this->keys = keys;
+
+    double sticks[4];
+    for (int i = 0; i < 4; i++)
+        sticks[i] = AxisIntegrator::Filter(sample[NAV_AXIS0 + i]/32767, this->deadzone, this->responseExponent);
+    events |= this->HandleGamepad(sticks, sample + NAV_AXIS4, (int)sample[NAV_BUTTONS]);
+    return events;
+}
+
+// ----------------------------------------------------------------------------
+int NavigationIntegrator::StartFlight(int target)
+{
+    int events = 0;
+    if (!this->flying)
+        events |= NAV_FLY_STARTED;
+    else if (target != this->flyto || target == 5)
+        events |= NAV_FLY_STOPPED | NAV_FLY_STARTED;
+    this->flyto = target;
+    this->flying = true;
+    return events;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Forward, sideways, roll, yaw, up and the flight, in that order. Stick
+// and key translation is scaled by the scene's speed factor at the start
+// of the step; every translation, flights included, goes through the
+// scene's collision.
+int NavigationIntegrator::Step(nav_pose* pose, double dt, NavigationScene* scene)
+{
+    this->speedScale = scene != NULL ? scene->SpeedScale(pose->position) : 1.0;
+
+    double dir[3];
+    directionOfProjection(pose, dir);
+
+    if (this->gamepadSpeed[1] != 0 || this->keyboardSpeed[1] != 0)
+    {
+        double delta = dt*clampSpeed(this->keyboardSpeed[1] + this->gamepadSpeed[1], this->maxSpeed);
+        double motion[3] = { dir[0]*delta, dir[1]*delta, dir[2]*delta };
+        this->Translate(pose, motion, scene);
+    }
+
+    if (this->gamepadSpeed[0] != 0 || this->keyboardSpeed[0] != 0)
+    {
+        double right[3];
+        cross(dir, pose->viewUp, right);
+        normalize(right);
+        double delta = dt*clampSpeed(this->keyboardSpeed[0] + this->gamepadSpeed[0], this->maxSpeed);
+        double motion[3] = { right[0]*delta, right[1]*delta, right[2]*delta };
+        this->Translate(pose, motion, scene);
+    }
+
+    // vtkCamera::Roll(): rotate the view up around the direction of
+    // projection
+    if (this->keyboardRoll != 0)
+    {
+        rotateVector(pose->viewUp, dir, this->keyboardRoll*dt);
+        orthogonalizeViewUp(pose);
+    }
+
+    // Mouse-look only turns along with the right stick
+    if (this->look[0] != 0)
+    {
+        double up[3] = { pose->viewUp[0], pose->viewUp[1], pose->viewUp[2] };
+        normalize(up);
+        yaw(pose, up, this->mouseYaw + this->look[0]*this->gamepadLookSpeed*dt);
+        orthogonalizeViewUp(pose);
+    }
+    this->mouseYaw = 0;
+
+    if (this->look[1] != 0)
+    {
+        double motion[3] = { 0, clampSpeed(this->look[1], this->maxSpeed)*dt, 0 };
+        this->Translate(pose, motion, scene);
+    }
+
+    return this->flying ? this->Fly(pose, dt, scene) : 0;
+}
+
+void NavigationIntegrator::Translate(nav_pose* pose, double* motion, NavigationScene* scene)
+{
+    for (int k = 0; k < 3; k++)
+        motion[k] *= this->speedScale;
+    if (scene != NULL)
+        scene->Collide(pose->position, motion);
+    translate(pose, motion);
+}
+
+// ----------------------------------------------------------------------------
+int NavigationIntegrator::Fly(nav_pose* pose, double dt, NavigationScene* scene)
+{
+    double destination[3], viewDir[3];
+    if (this->flyto == 5)
+        return this->FlyToPoint(pose, dt, scene);
+    if (GetBookmark(this->flyto, destination, viewDir))
+        return this->FlyTo(pose, dt, destination, viewDir, scene);
+    return 0;
+}
+
+bool NavigationIntegrator::GetBookmark(int target, double* destination, double* viewDir)
+{
+    static const double destinations[4][3] = { {0, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 0} };
+    static const double viewDirs[4][3] = { {1, 0, 0}, {0, -1, 0}, {0, 0, -1}, {-1, 0, 0} };
+    if (target < 1 || target > 4)
+        return false;
+    std::copy(destinations[target-1], destinations[target-1] + 3, destination);
+    std::copy(viewDirs[target-1], viewDirs[target-1] + 3, viewDir);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Bookmark flight: half a unit per second towards the destination while
+// turning 50 degrees per second towards the view direction. A flight
+// that runs into a surface is given up.
+int NavigationIntegrator::FlyTo(nav_pose* pose, double dt, const double* destination, const double* viewDir,
+                                NavigationScene* scene)
+{
+    bool transdone = false;
+    bool rotdone = false;
+    bool blocked = false;
+
+    double motion[3];
+    for (int i = 0; i < 3; i++)
+        motion[i] = destination[i] - pose->position[i];
+
+    if (norm(motion) > 0.1)
+    {
+        normalize(motion);
+        for (int i = 0; i < 3; i++)
+            motion[i] *= dt/2;
+        if (scene != NULL)
+            blocked = scene->Collide(pose->position, motion) < 0.5;
+        translate(pose, motion);
+        orthogonalizeViewUp(pose);
+    }
+    else
+        transdone = true;
+
+    double dir[3], axis[3];
+    directionOfProjection(pose, dir);
+    cross(dir, viewDir, axis);
+
+    if (norm(axis) > 0.1)
+    {
+        normalize(axis);
+        yaw(pose, axis, dt*50);
+        orthogonalizeViewUp(pose);
+    }
+    else
+        rotdone = true;
+
+    this->flying = !(transdone && rotdone) && !blocked;
+    if (blocked)
+        return NAV_FLY_STOPPED;
+    return this->flying ? 0 : NAV_FLY_ARRIVED;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Flight to a picked point: position and view direction close a fixed
+// fraction of the remaining gap per second, so the flight eases out
+// whatever its length. The focal distance is kept.
+int NavigationIntegrator::FlyToPoint(nav_pose* pose, double dt, NavigationScene* scene)
+{
+    double position[3], direction[3], target[3], remaining[3];
+    std::copy(pose->position, pose->position + 3, position);
+    for (int i = 0; i < 3; i++)
+        direction[i] = pose->focalPoint[i] - position[i];
+    double distance = normalize(direction);
+
+    double alpha = 1.0 - exp(-3.0*dt);
+    for (int i = 0; i < 3; i++)
+        remaining[i] = alpha*(this->flyDestination[i] - position[i]);
+    bool blocked = scene != NULL && scene->Collide(position, remaining) < 0.5;
+    for (int i = 0; i < 3; i++)
+        position[i] += remaining[i];
+
+    for (int i = 0; i < 3; i++)
+        target[i] = this->flyFocus[i] - position[i];
+    double focus = normalize(target);
+    for (int i = 0; i < 3; i++)
+        direction[i] += alpha*(target[i] - direction[i]);
+    normalize(direction);
+
+    // Done when the rest of the way is small compared to the distance left
+    // to the surface and the view is on the point
+    for (int i = 0; i < 3; i++)
+        remaining[i] = this->flyDestination[i] - position[i];
+    int events = 0;
+    if (blocked)
+    {
+        this->flying = false;
+        events = NAV_FLY_STOPPED;
+    }
+    else if (norm(remaining) < 0.01*focus && dot(direction, target) > 0.99996)
+    {
+        std::copy(this->flyDestination, this->flyDestination + 3, position);
+        std::copy(target, target + 3, direction);
+        this->flying = false;
+        events = NAV_FLY_ARRIVED;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        pose->position[i] = position[i];
+        pose->focalPoint[i] = position[i] + distance*direction[i];
+    }
+    orthogonalizeViewUp(pose);
+    return events;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Bookmark flights move at half a unit per second, pick flights close
+// the remaining distance exponentially. Mouse-look is left out, it comes
+// in bursts.
+void NavigationIntegrator::GetVelocity(const nav_pose* pose, double* velocity) const
+{
+    double dir[3], right[3];
+    directionOfProjection(pose, dir);
+    cross(dir, pose->viewUp, right);
+    normalize(right);
+
+    double forward = clampSpeed(this->keyboardSpeed[1] + this->gamepadSpeed[1], this->maxSpeed);
+    double side = clampSpeed(this->keyboardSpeed[0] + this->gamepadSpeed[0], this->maxSpeed);
+    double up = clampSpeed(this->look[1], this->maxSpeed);
+    for (int i = 0; i < 3; i++)
+        velocity[i] = (forward*dir[i] + side*right[i]) * this->speedScale;
+    velocity[1] += up * this->speedScale;
+
+    if (!this->flying)
+        return;
+
+    double destination[3], viewDir[3], remaining[3];
+    if (this->flyto == 5)
+    {
+        for (int i = 0; i < 3; i++)
+            remaining[i] = 3.0*(this->flyDestination[i] - pose->position[i]);
+    }
+    else if (GetBookmark(this->flyto, destination, viewDir))
+    {
+        for (int i = 0; i < 3; i++)
+            remaining[i] = destination[i] - pose->position[i];
+        double length = normalize(remaining);
+        for (int i = 0; i < 3; i++)
+            remaining[i] = length > 0.1 ? 0.5*remaining[i] : 0.0;
+    }
+    else
+        return;
+    for (int i = 0; i < 3; i++)
+        velocity[i] += remaining[i];
+}
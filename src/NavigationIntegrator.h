@@ -0,0 +1,165 @@
+#ifndef __NAVIGATIONINTEGRATOR_H__
+#define __NAVIGATIONINTEGRATOR_H__
+
+/*
+Render-free camera navigation integrator
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Camera pose as used by vtkCamera
+struct nav_pose {
+    double position[3];
+    double focalPoint[3];
+    double viewUp[3];
+};
+
+// Layout of one input sample for NavigationIntegrator::ApplySample() and
+// vtkInteractorStyleGame::SimulateNavigation(). Axis values use the raw
+// joystick range [-32767, 32767], buttons and keys are bit masks.
+enum nav_sample_column {
+    NAV_TIME = 0,       // seconds
+    NAV_AXIS0,          // left stick x
+    NAV_AXIS1,          // left stick y
+    NAV_AXIS2,          // right stick x
+    NAV_AXIS3,          // right stick y
+    NAV_AXIS4,          // d-pad axes, used unfiltered like in
+    NAV_AXIS5,          // handleGamepadState()
+    NAV_AXIS6,
+    NAV_BUTTONS,        // bit i set = gamepad button i pressed
+    NAV_KEYS,           // combination of nav_key bits
+    NAV_SAMPLE_SIZE
+};
+
+enum nav_key {
+    NAV_KEY_W = 1 << 0,
+    NAV_KEY_A = 1 << 1,
+    NAV_KEY_S = 1 << 2,
+    NAV_KEY_D = 1 << 3,
+    NAV_KEY_Q = 1 << 4,
+    NAV_KEY_E = 1 << 5,
+    NAV_KEY_BRACKETLEFT = 1 << 6,   // max speed down
+    NAV_KEY_BRACKETRIGHT = 1 << 7   // max speed up
+};
+
+// Changes reported by the integrator, same values as the corresponding
+// vtkInteractorStyleGame::InteractionChange bits
+enum nav_event {
+    NAV_MODE_CHANGED = 1,
+    NAV_SPEED_CHANGED = 2,
+    NAV_FLY_STARTED = 4,
+    NAV_FLY_STOPPED = 8,
+    NAV_FLY_ARRIVED = 16,
+    NAV_KEYS_CHANGED = 32
+};
+
+// Scene queries made while stepping. The defaults are an empty scene:
+// nothing to collide with and unit speed.
+class NavigationScene {
+public:
+    virtual ~NavigationScene() {}
+
+    // Limit the motion of the camera at from, e.g. against surfaces.
+    // Returns the fraction of the requested distance left in motion.
+    virtual double Collide(const double* /*from*/, double* /*motion*/) { return 1.0; }
+
+    // Factor applied to stick and key translation at position
+    virtual double SpeedScale(const double* /*position*/) { return 1.0; }
+};
+
+// The camera navigation of vtkInteractorStyleGame on a plain pose. Key
+// and gamepad input set the speeds, Step() moves the pose by them. The
+// style drives it from its events and OnTimer(), SimulateNavigation()
+// replays recorded or synthetic input samples through the same code
+// without a renderer, camera or interactor.
+class NavigationIntegrator {
+public:
+    NavigationIntegrator();
+
+    // Key press or release, a nav_key
+    int HandleKey(int key, bool down);
+
+    // Gamepad state: sticks are the filtered axes 0-3 in [-1, 1], dpad
+    // the raw axes 4-6, bit i of buttons is button i. The mode switch
+    // (button 9) acts on presses, the fly targets (buttons 1-4) start a
+    // flight while held.
+    int HandleGamepad(const double* sticks, const double* dpad, int buttons);
+
+    // Keys and gamepad of one input sample (nav_sample_column layout),
+    // in the order the style sees them: the key events between two ticks
+    // first, releases before presses, then the gamepad at the tick. Keys
+    // act on the transitions from the previous sample, so like key events
+    // the last key pressed wins over a held opposing one.
+    int ApplySample(const double* sample);
+
+    // Fly to a bookmark (1-4) or to flyDestination, looking at flyFocus
+    // (5). A flight under way to another target, or to an earlier pick,
+    // is given up.
+    int StartFlight(int target);
+
+    // Move the pose by the current speeds and flight for dt seconds.
+    // Returns nav_event bits.
+    int Step(nav_pose* pose, double dt, NavigationScene* scene);
+
+    // Translation velocity in world units per second at pose, from the
+    // speeds and flight of the last Step()
+    void GetVelocity(const nav_pose* pose, double* velocity) const;
+
+    // Destination and view direction of the fixed fly targets 1 to 4
+    static bool GetBookmark(int target, double* destination, double* viewDir);
+
+    double maxSpeed;
+    double gamepadLookSpeed;
+    bool turntableMode;
+    bool flying;
+    int flyto;
+    double flyDestination[3];   // camera position at the end of a pick flight
+    double flyFocus[3];         // picked point, looked at during the flight
+    double deadzone;            // stick filters of ApplySample(), see AxisIntegrator::Filter()
+    double responseExponent;
+    double keyboardSpeed[2];    // state left by earlier key presses
+    double keyboardRoll;
+    double gamepadSpeed[2];     // left stick (or d-pad) times maxSpeed
+    double look[2];             // right stick, kept while in turntable mode
+    double mouseYaw;            // degrees for the next Step(), applied with the stick yaw
+    double speedScale;          // scene speed factor of the last Step()
+
+private:
+    int Fly(nav_pose* pose, double dt, NavigationScene* scene);
+    int FlyTo(nav_pose* pose, double dt, const double* destination, const double* viewDir,
+              NavigationScene* scene);
+    int FlyToPoint(nav_pose* pose, double dt, NavigationScene* scene);
+    void Translate(nav_pose* pose, double* motion, NavigationScene* scene);
+    bool modeButtonDown;
+    int keys;                   // keys held in the previous sample
+};
+
+#endif
@@ -0,0 +1,488 @@
+/*
+Pointer capture backends for mouse-look
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "PointerCapture.h"
+
+#include <iostream>
+#include <math.h>
+
+#ifdef GAMEPAD_USE_X11
+#include <X11/Xlib.h>
+#ifdef GAMEPAD_USE_XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif
+
+// ----------------------------------------------------------------------------
+// Description:
+// XCheckIfEvent() predicate that never matches, so the queue is only
+// inspected. Pointer motion to the warp target is the echo of our own
+// warp and does not count as input.
+struct x11_pending_check {
+    Window window;
+    int center[2];          // warp target, or -1 when the pointer is not warped
+    bool found;
+};
+
+static Bool x11InputPredicate(Display*, XEvent* ev, XPointer arg)
+{
+    x11_pending_check* check = reinterpret_cast<x11_pending_check*>(arg);
+    if (ev->xany.window != check->window)
+        return False;
+    if (ev->type == KeyPress || ev->type == KeyRelease || ev->type == ButtonPress)
+        check->found = true;
+    if (ev->type == MotionNotify && (ev->xmotion.x != check->center[0] || ev->xmotion.y != check->center[1]))
+        check->found = true;
+    return False;
+}
+
+static bool x11InputPending(Display* display, Window window, int centerX, int centerY)
+{
+    x11_pending_check check = { window, { centerX, centerY }, false };
+    XEvent ev;
+    XCheckIfEvent(display, &ev, x11InputPredicate, reinterpret_cast<XPointer>(&check));
+    return check.found;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Whether the window has the keyboard focus, directly, through an
+// ancestor (e.g. a toolkit's top-level window it is embedded in) or
+// because the focus follows the pointer. Mouse-look must let go of the
+// pointer as soon as the user switches to another window.
+//
+// Asking the server is a round trip, too slow for every motion event and
+// tick. Focus changes are watched instead: a connection of our own
+// selects FocusChangeMask on the window, its ancestors and the root (the
+// windows a focus change that matters is reported on) and
+// StructureNotifyMask on the window for reparenting. The server is only
+// asked again after such an event arrived.
+struct x11_focus {
+    Display* events;        // own connection, so the interactor's queue is untouched
+    Window window;
+    bool stale;
+    bool focused;
+
+    x11_focus() : events(NULL), window(0), stale(true), focused(false) {}
+
+    ~x11_focus()
+    {
+        if (this->events != NULL)
+            XCloseDisplay(this->events);
+    }
+
+    bool Check(Display* display, Window window)
+    {
+        if (this->events == NULL)
+        {
+            this->events = XOpenDisplay(DisplayString(display));
+            if (this->events == NULL)
+                return this->Query(display, window);
+        }
+
+        if (window != this->window)
+        {
+            // The old window is left alone, it may be gone already; its
+            // events only cost a needless query
+            this->window = window;
+            this->Watch(window);
+            this->stale = true;
+        }
+
+        // Does not wait for the server, only reads what already arrived
+        while (XPending(this->events))
+        {
+            XEvent ev;
+            XNextEvent(this->events, &ev);
+            if (ev.type == FocusIn || ev.type == FocusOut)
+                this->stale = true;
+            else if (ev.type == ReparentNotify)
+            {
+                this->Watch(window);
+                this->stale = true;
+            }
+        }
+
+        if (this->stale)
+        {
+            this->focused = this->Query(display, window);
+            this->stale = false;
+        }
+        return this->focused;
+    }
+
+    // Select the focus events on window, its ancestors and the root
+    void Watch(Window window)
+    {
+        if (window == 0)
+            return;
+        XSelectInput(this->events, window, FocusChangeMask | StructureNotifyMask);
+        Window current = window;
+        while (current != 0)
+        {
+            Window root, parent, *children = NULL;
+            unsigned int count;
+            if (!XQueryTree(this->events, current, &root, &parent, &children, &count))
+                break;
+            if (children != NULL)
+                XFree(children);
+            XSelectInput(this->events, parent, FocusChangeMask);
+            current = parent == root ? 0 : parent;
+        }
+        XFlush(this->events);
+    }
+
+    static bool Query(Display* display, Window window)
+    {
+        Window focus;
+        int revert;
+        XGetInputFocus(display, &focus, &revert);
+        if (focus == PointerRoot)
+            return true;
+        if (focus == None)
+            return false;
+
+        for (Window current = window; current != 0; )
+        {
+            if (current == focus)
+                return true;
+            Window root, parent, *children = NULL;
+            unsigned int count;
+            if (!XQueryTree(display, current, &root, &parent, &children, &count))
+                break;
+            if (children != NULL)
+                XFree(children);
+            current = parent == root ? 0 : parent;
+        }
+        return false;
+    }
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Classic X11 mouse-look: measure the offset from the window center and
+// warp the pointer back to the center after every move.
+class X11PointerCapture : public PointerCapture {
+public:
+    X11PointerCapture(X11WindowSource* source) : source(source)
+    {
+        this->center[0] = this->center[1] = -1;
+    }
+
+    virtual ~X11PointerCapture()
+    {
+        delete this->source;
+    }
+
+    virtual bool Motion(const int* eventPos, const int* size, double* delta)
+    {
+        bool inside = eventPos[0] < size[0] && eventPos[1] < size[1];
+        if (inside)
+        {
+            delta[0] += eventPos[0] - roundl(size[0]/2);
+            delta[1] += (eventPos[1] + 1) - roundl(size[1]/2);
+        }
+
+        // Warp mouse to center of screen to grab the mouse
+        this->Recenter(size);
+        return inside;
+    }
+
+    virtual void Recenter(const int* size)
+    {
+        Display* display = static_cast<Display*>(this->source->GetDisplay());
+        Window window = this->source->GetWindow();
+        if (display == NULL || window == 0 || !this->focus.Check(display, window))
+            return;
+        this->center[0] = roundl(size[0]/2);
+        this->center[1] = roundl(size[1]/2);
+        XWarpPointer(display, window, window, 0, 0, size[0], size[1], this->center[0], this->center[1]);
+    }
+
+    virtual bool InputPending()
+    {
+        Display* display = static_cast<Display*>(this->source->GetDisplay());
+        Window window = this->source->GetWindow();
+        return display != NULL && window != 0 && x11InputPending(display, window, this->center[0], this->center[1]);
+    }
+
+private:
+    X11WindowSource* source;
+    x11_focus focus;
+    int center[2];
+};
+
+#ifdef GAMEPAD_USE_XINPUT2
+// ----------------------------------------------------------------------------
+// Description:
+// Mouse-look from XInput2 raw motion events. The pointer is confined to
+// the window with a grab instead of being warped back to the center, so
+// there are no synthetic motion events and no dead zone at the window
+// edge. Raw events are read from a second connection to the X server,
+// so they never end up in the interactor's event loop. The grab is given
+// up while the window does not have the focus; the server drops it by
+// itself when the window is unmapped.
+class XI2PointerCapture : public PointerCapture {
+public:
+    // Returns NULL when the server does not support XInput 2
+    static XI2PointerCapture* Create(X11WindowSource* source)
+    {
+        Display* display = static_cast<Display*>(source->GetDisplay());
+        Display* rawDisplay = XOpenDisplay(DisplayString(display));
+        if (rawDisplay == NULL)
+            return NULL;
+
+        int opcode, event, error;
+        int major = 2, minor = 0;
+        if (!XQueryExtension(rawDisplay, "XInputExtension", &opcode, &event, &error) ||
+            XIQueryVersion(rawDisplay, &major, &minor) != Success)
+        {
+            XCloseDisplay(rawDisplay);
+            return NULL;
+        }
+
+        // Raw events are only delivered to the root window
+        unsigned char bits[XIMaskLen(XI_LASTEVENT)] = {0};
+        XISetMask(bits, XI_RawMotion);
+
+        XIEventMask mask;
+        mask.deviceid = XIAllMasterDevices;
+        mask.mask_len = sizeof(bits);
+        mask.mask = bits;
+        XISelectEvents(rawDisplay, DefaultRootWindow(rawDisplay), &mask, 1);
+        XFlush(rawDisplay);
+
+        return new XI2PointerCapture(source, rawDisplay, opcode);
+    }
+
+    virtual ~XI2PointerCapture()
+    {
+        Display* display = static_cast<Display*>(this->source->GetDisplay());
+        if (this->grabbed && display != NULL)
+        {
+            XUngrabPointer(display, CurrentTime);
+            XFlush(display);
+        }
+        XCloseDisplay(this->rawDisplay);
+        delete this->source;
+    }
+
+    virtual bool Motion(const int* /*eventPos*/, const int* /*size*/, double* /*delta*/)
+    {
+        // Pointer positions are meaningless while grabbed, all motion
+        // comes from Poll()
+        return true;
+    }
+
+    virtual void Poll(double* delta)
+    {
+        this->Update();
+        while (XPending(this->rawDisplay))
+        {
+            XEvent ev;
+            XNextEvent(this->rawDisplay, &ev);
+
+            XGenericEventCookie* cookie = &ev.xcookie;
+            // The server released the grab
+            if (ev.type == UnmapNotify)
+                this->grabbed = false;
+
+            if (cookie->type != GenericEvent || cookie->extension != this->opcode ||
+                !XGetEventData(this->rawDisplay, cookie))
+                continue;
+
+            if (cookie->evtype == XI_RawMotion && this->grabbed)
+            {
+                // Unaccelerated values, packed for the valuators set in the mask
+                XIRawEvent* raw = static_cast<XIRawEvent*>(cookie->data);
+                const double* values = raw->raw_values;
+                for (int i = 0; i < raw->valuators.mask_len*8 && i < 2; i++)
+                {
+                    if (!XIMaskIsSet(raw->valuators.mask, i))
+                        continue;
+                    // X11 y points down, VTK's event positions point up
+                    double value = *values++;
+                    delta[i] += i == 0 ? value : -value;
+                }
+            }
+
+            XFreeEventData(this->rawDisplay, cookie);
+        }
+    }
+
+    virtual void Recenter(const int* /*size*/)
+    {
+        Display* display = this->Update();
+        if (display == NULL)
+            return;
+
+        if (!this->focus.Check(display, this->window))
+        {
+            if (this->grabbed)
+            {
+                XUngrabPointer(display, CurrentTime);
+                XFlush(display);
+                this->grabbed = false;
+            }
+        }
+        else if (!this->grabbed)
+        {
+            // Keep trying to grab until the window is viewable
+            this->grabbed = XGrabPointer(display, this->window, True,
+                PointerMotionMask | ButtonPressMask | ButtonReleaseMask,
+                GrabModeAsync, GrabModeAsync, this->window, None, CurrentTime) == GrabSuccess;
+        }
+    }
+
+    virtual bool InputPending()
+    {
+        Display* display = this->Update();
+        return (this->grabbed && XPending(this->rawDisplay) > 0) ||
+               (display != NULL && x11InputPending(display, this->window, -1, -1));
+    }
+
+private:
+    XI2PointerCapture(X11WindowSource* source, Display* rawDisplay, int opcode)
+        : source(source), window(0), rawDisplay(rawDisplay), opcode(opcode), grabbed(false) {}
+
+    // The current display, NULL when there is no window. A grab on a
+    // window that was replaced is given up, it is taken again for the
+    // new window by the next Recenter().
+    Display* Update()
+    {
+        Display* display = static_cast<Display*>(this->source->GetDisplay());
+        Window window = this->source->GetWindow();
+        if (window != this->window)
+        {
+            if (this->grabbed && display != NULL)
+                XUngrabPointer(display, CurrentTime);
+            this->grabbed = false;
+            this->window = window;
+
+            // Unmap notifications arrive with the raw events
+            if (window != 0)
+            {
+                XSelectInput(this->rawDisplay, window, StructureNotifyMask);
+                XFlush(this->rawDisplay);
+            }
+        }
+        return window != 0 ? display : NULL;
+    }
+
+    X11WindowSource* source;
+    Window window;          // window the grab belongs to
+    Display* rawDisplay;
+    int opcode;
+    x11_focus focus;
+    bool grabbed;
+};
+#endif
+#endif
+
+// ----------------------------------------------------------------------------
+// Description:
+// The source is asked for the window once here, later calls go through
+// it again so a recreated window is picked up.
+PointerCapture* PointerCapture::CreateX11(X11WindowSource* source)
+{
+#ifdef GAMEPAD_USE_X11
+    if (source->GetDisplay() != NULL && source->GetWindow() != 0)
+    {
+#ifdef GAMEPAD_USE_XINPUT2
+        PointerCapture* raw = XI2PointerCapture::Create(source);
+        if (raw != NULL)
+            return raw;
+        std::cout << "XInput 2 not available, falling back to pointer warping" << std::endl;
+#endif
+        return new X11PointerCapture(source);
+    }
+#endif
+
+    delete source;
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+OffscreenPointerCapture::OffscreenPointerCapture() : havePosition(false)
+{
+    this->lastPosition[0] = 0;
+    this->lastPosition[1] = 0;
+}
+
+bool OffscreenPointerCapture::Motion(const int* eventPos, const int* /*size*/, double* delta)
+{
+    if (this->havePosition)
+    {
+        delta[0] += eventPos[0] - this->lastPosition[0];
+        delta[1] += eventPos[1] - this->lastPosition[1];
+    }
+
+    this->lastPosition[0] = eventPos[0];
+    this->lastPosition[1] = eventPos[1];
+    this->havePosition = true;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+InjectedPointerCapture::InjectedPointerCapture()
+{
+    this->pending[0] = 0;
+    this->pending[1] = 0;
+}
+
+bool InjectedPointerCapture::Motion(const int* /*eventPos*/, const int* /*size*/, double* /*delta*/)
+{
+    // Real pointer events are ignored, only injected motion counts
+    return true;
+}
+
+void InjectedPointerCapture::Poll(double* delta)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    delta[0] += this->pending[0];
+    delta[1] += this->pending[1];
+    this->pending[0] = 0;
+    this->pending[1] = 0;
+}
+
+bool InjectedPointerCapture::InputPending()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->pending[0] != 0 || this->pending[1] != 0;
+}
+
+void InjectedPointerCapture::Inject(double dx, double dy)
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->pending[0] += dx;
+    this->pending[1] += dy;
+}
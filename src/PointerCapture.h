@@ -0,0 +1,114 @@
+#ifndef __POINTERCAPTURE_H__
+#define __POINTERCAPTURE_H__
+
+/*
+Pointer capture backends for mouse-look
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <mutex>
+
+// Where the X11 backends get the display connection and window from.
+// They ask on every use instead of keeping them, because VTK replaces the
+// window when it recreates it (e.g. when toggling full screen).
+class X11WindowSource {
+public:
+    virtual ~X11WindowSource() {}
+    virtual void* GetDisplay() = 0;         // Display*
+    virtual unsigned long GetWindow() = 0;  // Window, 0 when there is none yet
+};
+
+// Grabs the pointer for mouse-look and turns pointer movement into
+// relative motion. The window system specific parts live behind this
+// interface so the interactor style never has to know what kind of
+// render window it is attached to.
+class PointerCapture {
+public:
+    virtual ~PointerCapture() {}
+
+    // Pointer moved to eventPos in a window of the given size. Adds the
+    // relative motion to delta[2] and returns false when the motion
+    // should be discarded.
+    virtual bool Motion(const int* eventPos, const int* size, double* delta) = 0;
+
+    // Adds relative motion that did not arrive through the interactor's
+    // mouse move events since the last call to delta[2].
+    virtual void Poll(double* /*delta*/) {}
+
+    // Called once per timer tick, after the motion has been applied
+    virtual void Recenter(const int* /*size*/) {}
+
+    // True when keyboard or pointer input for the window is waiting to be
+    // handled. Called from render abort checks, so it must not consume
+    // anything.
+    virtual bool InputPending() { return false; }
+
+    // Backend for an on-screen X11 window: XInput 2 raw motion when the
+    // server supports it, pointer warping otherwise. Takes ownership of
+    // source. Returns NULL when built without X11 support or when the
+    // window has not been created yet, so the caller can try again later.
+    static PointerCapture* CreateX11(X11WindowSource* source);
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Backend for offscreen, EGL and OSMesa windows. There is no pointer to
+// grab, so relative motion is taken between consecutive mouse events.
+class OffscreenPointerCapture : public PointerCapture {
+public:
+    OffscreenPointerCapture();
+    virtual bool Motion(const int* eventPos, const int* size, double* delta);
+
+private:
+    bool havePosition;
+    int lastPosition[2];
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Backend that ignores the window system completely and only reports the
+// motion handed to Inject(). Used for tests and scripted input; Inject()
+// may be called from any thread.
+class InjectedPointerCapture : public PointerCapture {
+public:
+    InjectedPointerCapture();
+    virtual bool Motion(const int* eventPos, const int* size, double* delta);
+    virtual void Poll(double* delta);
+    virtual bool InputPending();
+    void Inject(double dx, double dy);
+
+private:
+    std::mutex lock;
+    double pending[2];
+};
+
+#endif
@@ -0,0 +1,399 @@
+/*
+Bounding volume hierarchy over the scene geometry
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "SceneBVH.h"
+
+#include "vtkActor.h"
+#include "vtkCellArray.h"
+#include "vtkDataArray.h"
+#include "vtkIdTypeArray.h"
+#include "vtkMapper.h"
+#include "vtkMatrix4x4.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkPropCollection.h"
+#include "vtkRenderer.h"
+
+#include <algorithm>
+#include <float.h>
+#include <map>
+#include <math.h>
+
+// ----------------------------------------------------------------------------
+// Description:
+// Collect the triangles of polys and triangle strips. Only the raw arrays
+// are read, nothing in the polydata is modified, so this is safe on a
+// shallow copy while the pipeline keeps using the original.
+static void extractTriangles(vtkPolyData* pd, std::vector<float>& triangles)
+{
+    vtkPoints* points = pd->GetPoints();
+    if (points == NULL)
+        return;
+    vtkDataArray* coords = points->GetData();
+
+    vtkCellArray* cells[2] = { pd->GetPolys(), pd->GetStrips() };
+    for (int c = 0; c < 2; c++)
+    {
+        if (cells[c] == NULL)
+            continue;
+
+        vtkIdTypeArray* connectivity = cells[c]->GetData();
+        vtkIdType size = connectivity->GetNumberOfTuples();
+        const vtkIdType* data = connectivity->GetPointer(0);
+
+        for (vtkIdType i = 0; i < size; i += data[i] + 1)
+        {
+            vtkIdType npts = data[i];
+            const vtkIdType* ids = data + i + 1;
+            for (vtkIdType k = 0; k + 2 < npts; k++)
+            {
+                // Polygons as fans, strips as consecutive triples
+                vtkIdType tri[3] = { c == 0 ? ids[0] : ids[k], ids[k+1], ids[k+2] };
+                for (int v = 0; v < 3; v++)
+                {
+                    double x[3];
+                    coords->GetTuple(tri[v], x);
+                    triangles.push_back(x[0]);
+                    triangles.push_back(x[1]);
+                    triangles.push_back(x[2]);
+                }
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+SceneBVH::SceneBVH() : queryBudget(4096), version(0), geometryVersion(0), stopping(false)
+{
+    this->worker = std::thread(&SceneBVH::work, this);
+}
+
+SceneBVH::~SceneBVH()
+{
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->wakeup.notify_all();
+    this->worker.join();
+
+    for (size_t i = 0; i < this->queued.size(); i++)
+        this->queued[i].snapshot->Delete();
+    for (size_t i = 0; i < this->finished.size(); i++)
+        this->finished[i].snapshot->Delete();
+}
+
+// ----------------------------------------------------------------------------
+void SceneBVH::work(SceneBVH* self)
+{
+    std::unique_lock<std::mutex> guard(self->lock);
+    while (true)
+    {
+        self->wakeup.wait(guard, [self] { return self->stopping || !self->queued.empty(); });
+        if (self->stopping)
+            return;
+
+        job j = self->queued.front();
+        self->queued.pop_front();
+        guard.unlock();
+
+        std::vector<float> triangles;
+        extractTriangles(j.snapshot, triangles);
+        j.result = std::make_shared<TriangleBVH>();
+        j.result->Build(triangles);
+
+        guard.lock();
+        self->finished.push_back(j);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Sync with the renderer's visible actors. Costs one pass over the props;
+// geometry is only processed (on the worker) for props whose polydata
+// changed.
+void SceneBVH::Update(vtkRenderer* ren)
+{
+    std::vector<job> done;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        done.swap(this->finished);
+    }
+
+    std::map<vtkProp3D*, size_t> index;
+    for (size_t i = 0; i < this->instances.size(); i++)
+        index[this->instances[i].prop] = i;
+
+    // Adopt finished builds, unless the prop changed again in the meantime
+    for (size_t i = 0; i < done.size(); i++)
+    {
+        std::map<vtkProp3D*, size_t>::iterator it = index.find(done[i].prop);
+        if (it != index.end() && this->instances[it->second].pendingTime == done[i].dataTime)
+        {
+            bvh_instance& inst = this->instances[it->second];
+            inst.bvh = done[i].result;
+            inst.dataTime = done[i].dataTime;
+            inst.pendingTime = 0;
+            this->version++;
+            this->geometryVersion++;
+        }
+        done[i].snapshot->Delete();
+    }
+
+    std::vector<bvh_instance> current;
+    std::vector<job> jobs;
+    vtkPropCollection* props = ren->GetViewProps();
+    props->InitTraversal();
+    for (vtkProp* prop = props->GetNextProp(); prop != NULL; prop = props->GetNextProp())
+    {
+        vtkActor* actor = vtkActor::SafeDownCast(prop);
+        if (actor == NULL || !actor->GetVisibility() || actor->GetMapper() == NULL)
+            continue;
+        vtkPolyData* pd = vtkPolyData::SafeDownCast(actor->GetMapper()->GetInput());
+        if (pd == NULL || pd->GetPoints() == NULL)
+            continue;
+
+        std::map<vtkProp3D*, size_t>::iterator it = index.find(actor);
+        bvh_instance inst;
+        if (it != index.end())
+            inst = this->instances[it->second];
+        else
+        {
+            inst.prop = actor;
+            inst.dataTime = 0;
+            inst.pendingTime = 0;
+            this->geometryVersion++;
+        }
+
+        // Moving a prop only changes its transform
+        double matrix[16];
+        actor->GetMatrix(matrix);
+        if (it == index.end() || !std::equal(matrix, matrix + 16, inst.matrix))
+        {
+            std::copy(matrix, matrix + 16, inst.matrix);
+            vtkMatrix4x4::Invert(inst.matrix, inst.inverse);
+            inst.scale = DBL_MAX;
+            for (int c = 0; c < 3; c++)
+                inst.scale = std::min(inst.scale, sqrt(matrix[c]*matrix[c] + matrix[4+c]*matrix[4+c] + matrix[8+c]*matrix[8+c]));
+            this->version++;
+        }
+        std::copy(actor->GetBounds(), actor->GetBounds() + 6, inst.bounds);
+
+        unsigned long dataTime = pd->GetMTime();
+        if (dataTime != inst.dataTime && dataTime != inst.pendingTime)
+        {
+            job j;
+            j.prop = actor;
+            j.dataTime = dataTime;
+            j.snapshot = vtkPolyData::New();
+            j.snapshot->ShallowCopy(pd);
+            jobs.push_back(j);
+            inst.pendingTime = dataTime;
+        }
+
+        current.push_back(inst);
+    }
+    if (current.size() != this->instances.size())
+    {
+        this->version++;
+        this->geometryVersion++;
+    }
+    this->instances.swap(current);
+
+    if (jobs.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            // A newer version replaces a build that has not started yet
+            bool replaced = false;
+            for (size_t q = 0; q < this->queued.size() && !replaced; q++)
+            {
+                if (this->queued[q].prop == jobs[i].prop)
+                {
+                    this->queued[q].snapshot->Delete();
+                    this->queued[q] = jobs[i];
+                    replaced = true;
+                }
+            }
+            if (!replaced)
+                this->queued.push_back(jobs[i]);
+        }
+    }
+    this->wakeup.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+bvh_raycast SceneBVH::Raycast(const double* origin, const double* dir, double* t, double* normal) const
+{
+    return SceneBVH::Raycast(this->instances, origin, dir, t, normal, this->queryBudget);
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Test the props whose world bounds the segment touches, each in its own
+// local coordinates. The segment parameter is the same in both spaces
+// because the direction is transformed along without normalizing.
+bvh_raycast SceneBVH::Raycast(const std::vector<bvh_instance>& instances, const double* origin, const double* dir,
+                              double* t, double* normal, int budget)
+{
+    bool hit = false;
+    bool complete = true;
+    double best = 1.0;
+
+    for (size_t i = 0; i < instances.size() && complete; i++)
+    {
+        const bvh_instance& inst = instances[i];
+        if (!inst.bvh)
+            continue;
+
+        // Quick rejection on the world bounds
+        float lo[3], hi[3];
+        double invDir[3];
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = inst.bounds[2*k];
+            hi[k] = inst.bounds[2*k+1];
+            invDir[k] = dir[k] != 0 ? 1/dir[k] : (dir[k] < 0 ? -DBL_MAX : DBL_MAX);
+        }
+        if (!TriangleBVH::SegmentHitsBox(lo, hi, origin, invDir, best))
+            continue;
+
+        const double* m = inst.inverse;
+        double o[3], d[3];
+        for (int r = 0; r < 3; r++)
+        {
+            o[r] = m[4*r]*origin[0] + m[4*r+1]*origin[1] + m[4*r+2]*origin[2] + m[4*r+3];
+            d[r] = m[4*r]*dir[0] + m[4*r+1]*dir[1] + m[4*r+2]*dir[2];
+        }
+
+        double ti, ni[3];
+        bvh_raycast result = inst.bvh->Raycast(o, d, best, &ti, ni, &budget);
+        complete = result != BVH_UNKNOWN;
+        if (result == BVH_HIT)
+        {
+            best = ti;
+            hit = true;
+            // Normals transform with the inverse transpose
+            for (int c = 0; c < 3; c++)
+                normal[c] = m[c]*ni[0] + m[4+c]*ni[1] + m[8+c]*ni[2];
+        }
+    }
+
+    if (hit)
+    {
+        *t = best;
+        double length = sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+        if (length > 0)
+            for (int k = 0; k < 3; k++)
+                normal[k] /= length;
+    }
+    return !complete ? BVH_UNKNOWN : hit ? BVH_HIT : BVH_MISS;
+}
+
+// ----------------------------------------------------------------------------
+double SceneBVH::Distance(const double* p, double maxDistance) const
+{
+    return SceneBVH::Distance(this->instances, p, maxDistance, this->queryBudget);
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Local distances are converted with the smallest axis scale of the
+// prop's transform, which never overestimates the clearance. Props left
+// over when the budget ran out count with their bounds.
+double SceneBVH::Distance(const std::vector<bvh_instance>& instances, const double* p, double maxDistance, int budget)
+{
+    double best = maxDistance;
+
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const bvh_instance& inst = instances[i];
+        if (!inst.bvh || inst.scale <= 0)
+            continue;
+
+        float lo[3], hi[3];
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = inst.bounds[2*k];
+            hi[k] = inst.bounds[2*k+1];
+        }
+        double boxDistance = TriangleBVH::DistanceToBox(lo, hi, p);
+        if (boxDistance >= best)
+            continue;
+        if (budget <= 0)
+        {
+            best = boxDistance;
+            continue;
+        }
+
+        const double* m = inst.inverse;
+        double local[3];
+        for (int r = 0; r < 3; r++)
+            local[r] = m[4*r]*p[0] + m[4*r+1]*p[1] + m[4*r+2]*p[2] + m[4*r+3];
+
+        best = std::min(best, inst.bvh->Distance(local, best/inst.scale, &budget)*inst.scale);
+    }
+
+    return best;
+}
+
+// ----------------------------------------------------------------------------
+bool SceneBVH::IsComplete() const
+{
+    for (size_t i = 0; i < this->instances.size(); i++)
+        if (!this->instances[i].bvh)
+            return false;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+bool SceneBVH::GetBounds(double* bounds) const
+{
+    bool found = false;
+    for (size_t i = 0; i < this->instances.size(); i++)
+    {
+        const bvh_instance& inst = this->instances[i];
+        if (!inst.bvh)
+            continue;
+        for (int k = 0; k < 3; k++)
+        {
+            bounds[2*k] = found ? std::min(bounds[2*k], inst.bounds[2*k]) : inst.bounds[2*k];
+            bounds[2*k+1] = found ? std::max(bounds[2*k+1], inst.bounds[2*k+1]) : inst.bounds[2*k+1];
+        }
+        found = true;
+    }
+    return found;
+}
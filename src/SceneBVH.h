@@ -0,0 +1,133 @@
+#ifndef __SCENEBVH_H__
+#define __SCENEBVH_H__
+
+/*
+Bounding volume hierarchy over the scene geometry
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TriangleBVH.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class vtkPolyData;
+class vtkProp3D;
+class vtkRenderer;
+
+// One prop in the scene: its BVH plus the transform it is placed with
+struct bvh_instance {
+    vtkProp3D* prop;
+    unsigned long dataTime;         // MTime of the polydata the BVH was built from
+    unsigned long pendingTime;      // MTime of the polydata being built, if any
+    double matrix[16];              // local -> world
+    double inverse[16];             // world -> local
+    double bounds[6];               // world space
+    double scale;                   // smallest axis scale of matrix
+    std::shared_ptr<const TriangleBVH> bvh;
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Two-level BVH over the visible actors of a renderer. Update() is called
+// on the interactor thread every tick; it picks up moved props directly
+// (only their transform changes) and hands props with new geometry to a
+// background thread. Queries keep using the previous BVH of a prop until
+// its rebuild is done, so navigation never waits for a build.
+class SceneBVH {
+public:
+    SceneBVH();
+    ~SceneBVH();
+
+    void Update(vtkRenderer* ren);
+
+    // Nearest hit along the segment origin + t*dir, t in [0, 1]. Returns
+    // the hit parameter and the world space surface normal. BVH_UNKNOWN
+    // when queryBudget ran out first, callers must not take that as free
+    // space.
+    bvh_raycast Raycast(const double* origin, const double* dir, double* t, double* normal) const;
+
+    // Copy of the current instances, for queries from other threads
+    std::vector<bvh_instance> GetInstances() const { return this->instances; }
+
+    static bvh_raycast Raycast(const std::vector<bvh_instance>& instances, const double* origin, const double* dir,
+                               double* t, double* normal, int budget);
+
+    // Distance from p to the nearest surface, capped at maxDistance. A
+    // lower bound when queryBudget runs out first.
+    double Distance(const double* p, double maxDistance) const;
+    static double Distance(const std::vector<bvh_instance>& instances, const double* p, double maxDistance, int budget);
+
+    // Bounds of all instances, false when the scene is empty
+    bool GetBounds(double* bounds) const;
+
+    // True when every prop has a BVH, a prop being rebuilt counts with
+    // its previous one
+    bool IsComplete() const;
+
+    // Changes whenever a query could give a different answer
+    unsigned long GetVersion() const { return this->version; }
+
+    // Changes when props are added or removed or their geometry was
+    // rebuilt; moving a prop only changes GetVersion()
+    unsigned long GetGeometryVersion() const { return this->geometryVersion; }
+
+    // Maximum number of BVH nodes visited per query
+    int queryBudget;
+
+private:
+    struct job {
+        vtkProp3D* prop;
+        unsigned long dataTime;
+        vtkPolyData* snapshot;      // shallow copy, owned by the interactor thread
+        std::shared_ptr<TriangleBVH> result;
+    };
+
+    static void work(SceneBVH* self);
+
+    std::vector<bvh_instance> instances;
+    unsigned long version;
+    unsigned long geometryVersion;
+
+    std::mutex lock;
+    std::condition_variable wakeup;
+    std::deque<job> queued;
+    std::vector<job> finished;
+    bool stopping;
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+Asynchronous picking against the scene BVH
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ScenePicker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+
+// ----------------------------------------------------------------------------
+ScenePicker::ScenePicker() : pending(false)
+{
+}
+
+void ScenePicker::Request(const double* origin, const double* direction)
+{
+    std::copy(origin, origin + 3, this->request.origin);
+    std::copy(direction, direction + 3, this->request.direction);
+    this->pending = true;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Full traversal, off the interactor thread there is no need for a node
+// budget.
+pick_result ScenePicker::Pick(std::vector<bvh_instance> instances, pick_ray ray)
+{
+    pick_result result;
+    result.ray = ray;
+    result.hit = SceneBVH::Raycast(instances, ray.origin, ray.direction, &result.t, result.normal, INT_MAX) == BVH_HIT;
+    for (int k = 0; k < 3; k++)
+        result.point[k] = result.hit ? ray.origin[k] + result.t*ray.direction[k] : 0.0;
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+bool ScenePicker::Update(const SceneBVH* scene, pick_result* result)
+{
+    bool finished = false;
+    if (this->job.valid() && this->job.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        *result = this->job.get();
+        finished = !this->pending;
+    }
+
+    // Until the BVHs are built a pick would miss props
+    double bounds[6];
+    if (this->pending && !this->job.valid() && scene->GetBounds(bounds) && scene->IsComplete())
+    {
+        this->job = std::async(std::launch::async, &ScenePicker::Pick, scene->GetInstances(), this->request);
+        this->pending = false;
+    }
+
+    return finished;
+}
@@ -0,0 +1,86 @@
+#ifndef __SCENEPICKER_H__
+#define __SCENEPICKER_H__
+
+/*
+Asynchronous picking against the scene BVH
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SceneBVH.h"
+
+#include <future>
+#include <vector>
+
+struct pick_ray {
+    double origin[3];
+    double direction[3];    // segment end is origin + direction
+};
+
+struct pick_result {
+    bool hit;
+    double t;               // hit parameter along the ray, in [0, 1]
+    double point[3];
+    double normal[3];
+    pick_ray ray;           // the ray the result belongs to
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Picks run on a worker thread against a copy of the scene BVH's
+// instances, so a pick on a large scene never holds up the interactor
+// thread. There is at most one pick in flight; a request made meanwhile
+// waits, and a newer request replaces a waiting one. Results of picks
+// that were superseded are dropped.
+class ScenePicker {
+public:
+    ScenePicker();
+
+    // Queue a pick along the segment from origin to origin + direction.
+    // The ray should be taken from the camera at request time.
+    void Request(const double* origin, const double* direction);
+
+    // Called once per tick on the interactor thread. Starts the waiting
+    // request once every prop of the scene has its BVH, returns true when
+    // a pick finished and stores it in result.
+    bool Update(const SceneBVH* scene, pick_result* result);
+
+    bool Busy() const { return this->pending || this->job.valid(); }
+
+private:
+    static pick_result Pick(std::vector<bvh_instance> instances, pick_ray ray);
+
+    bool pending;
+    pick_ray request;
+    std::future<pick_result> job;
+};
+
+#endif
@@ -0,0 +1,165 @@
+/*
+Shared-memory export of camera pose and input state
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "SharedState.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <iostream>
+
+// ----------------------------------------------------------------------------
+SharedStateWriter::SharedStateWriter() : segment(0)
+{
+    this->name[0] = 0;
+}
+
+SharedStateWriter::~SharedStateWriter()
+{
+    if (this->segment != 0)
+    {
+        munmap(this->segment, sizeof(shared_state_segment));
+        shm_unlink(this->name);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Create (or take over) the POSIX shared memory segment, e.g. "/vtkgame"
+bool SharedStateWriter::Open(const char* name)
+{
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(shared_state_segment)) < 0)
+    {
+        std::cout << "WARNING: shared memory " << name << " could not be created: " << strerror(errno) << std::endl;
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    void* mem = mmap(0, sizeof(shared_state_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        std::cout << "WARNING: shared memory " << name << " could not be mapped: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    strncpy(this->name, name, sizeof(this->name) - 1);
+    this->name[sizeof(this->name) - 1] = 0;
+
+    this->segment = (shared_state_segment*)mem;
+    memset(&this->segment->state, 0, sizeof(shared_state));
+    this->segment->sequence.store(0, std::memory_order_relaxed);
+    this->segment->size = sizeof(shared_state_segment);
+    this->segment->version = SHARED_STATE_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    this->segment->magic = SHARED_STATE_MAGIC;
+
+    std::cout << "Exporting camera and input state to shared memory " << name << std::endl;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+void SharedStateWriter::Publish(const shared_state* state)
+{
+    if (this->segment == 0)
+        return;
+
+    uint32_t sequence = this->segment->sequence.load(std::memory_order_relaxed);
+    this->segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&this->segment->state, state, sizeof(shared_state));
+
+    this->segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+SharedStateReader::SharedStateReader() : segment(0)
+{
+}
+
+SharedStateReader::~SharedStateReader()
+{
+    if (this->segment != 0)
+        munmap((void*)this->segment, sizeof(shared_state_segment));
+}
+
+// ----------------------------------------------------------------------------
+bool SharedStateReader::Open(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    void* mem = mmap(0, sizeof(shared_state_segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return false;
+
+    const shared_state_segment* segment = (const shared_state_segment*)mem;
+    if (segment->magic != SHARED_STATE_MAGIC || segment->version != SHARED_STATE_VERSION ||
+        segment->size != sizeof(shared_state_segment))
+    {
+        munmap(mem, sizeof(shared_state_segment));
+        return false;
+    }
+
+    this->segment = segment;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+bool SharedStateReader::Read(shared_state* state)
+{
+    if (this->segment == 0)
+        return false;
+
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        uint32_t before = this->segment->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        memcpy(state, (const void*)&this->segment->state, sizeof(shared_state));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (this->segment->sequence.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+
+    return false;
+}
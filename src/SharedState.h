@@ -0,0 +1,116 @@
+#ifndef __SHAREDSTATE_H__
+#define __SHAREDSTATE_H__
+
+/*
+Shared-memory export of camera pose and input state
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <atomic>
+#include <stdint.h>
+
+#define SHARED_STATE_MAGIC      0x47535453  /* "GSTS" */
+#define SHARED_STATE_VERSION    1
+#define SHARED_STATE_AXES       16
+#define SHARED_STATE_BUTTONS    32
+
+#define SHARED_STATE_TURNTABLE  0x01
+#define SHARED_STATE_FLYING     0x02
+#define SHARED_STATE_ADVANCED   0x04
+#define SHARED_STATE_GAMEPAD    0x08    /* gamepad snapshot is valid */
+
+// Snapshot written once per tick
+struct shared_state {
+    uint64_t frame;
+    double time;            /* CLOCK_MONOTONIC seconds */
+    double frameTime;       /* length of the tick, seconds */
+    double position[3];
+    double focalPoint[3];
+    double viewUp[3];
+    double viewAngle;
+    double maxSpeed;
+    double gamepadSpeed[2];
+    double keyboardSpeed[2];
+    double lookSpeed[2];
+    uint32_t flags;
+    int32_t flyto;
+    uint32_t axes;
+    uint32_t buttons;
+    int16_t axis[SHARED_STATE_AXES];
+    int16_t button[SHARED_STATE_BUTTONS];
+};
+
+// Layout of the shared memory segment. The sequence number is a seqlock:
+// odd while the writer updates the state, incremented again when done.
+struct shared_state_segment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;          /* sizeof(shared_state_segment) of the writer */
+    std::atomic<uint32_t> sequence;
+    shared_state state;
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Writer side, owned by the interactor style. Publishing is a couple of
+// stores and a memcpy, no system calls.
+class SharedStateWriter {
+public:
+    SharedStateWriter();
+    ~SharedStateWriter();
+    bool Open(const char* name);
+    void Publish(const shared_state* state);
+
+private:
+    char name[256];
+    shared_state_segment* segment;
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Reader side for other processes (HUD overlays, recorders, ...). Read()
+// never blocks the writer; it retries while a write is in progress.
+class SharedStateReader {
+public:
+    SharedStateReader();
+    ~SharedStateReader();
+    bool Open(const char* name);
+
+    // Copy the latest consistent state. Returns false when no consistent
+    // copy could be taken within a few attempts.
+    bool Read(shared_state* state);
+
+private:
+    const shared_state_segment* segment;
+};
+
+#endif
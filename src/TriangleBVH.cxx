@@ -0,0 +1,378 @@
+/*
+Bounding volume hierarchy over a triangle mesh
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+#define BVH_LEAF_SIZE 4
+#define BVH_STACK_SIZE 64
+
+// ----------------------------------------------------------------------------
+// Description:
+// Build the hierarchy and store the triangles in leaf order
+void TriangleBVH::Build(std::vector<float>& triangles)
+{
+    this->triangles.swap(triangles);
+    this->nodes.clear();
+
+    int count = this->triangles.size()/9;
+    std::vector<int32_t> order(count);
+    std::vector<float> centroids(3*count);
+    for (int i = 0; i < count; i++)
+    {
+        order[i] = i;
+        const float* tri = &this->triangles[9*i];
+        for (int k = 0; k < 3; k++)
+            centroids[3*i+k] = (tri[k] + tri[3+k] + tri[6+k])/3;
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        this->bounds[2*k] = 0;
+        this->bounds[2*k+1] = 0;
+    }
+    if (count == 0)
+        return;
+
+    this->nodes.reserve(2*count/BVH_LEAF_SIZE + 1);
+    this->nodes.push_back(node());
+    this->BuildNode(0, order, centroids, 0, count);
+
+    std::vector<float> sorted(this->triangles.size());
+    for (int i = 0; i < count; i++)
+        std::copy(&this->triangles[9*order[i]], &this->triangles[9*order[i]] + 9, &sorted[9*i]);
+    this->triangles.swap(sorted);
+
+    for (int k = 0; k < 3; k++)
+    {
+        this->bounds[2*k] = this->nodes[0].lo[k];
+        this->bounds[2*k+1] = this->nodes[0].hi[k];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Top-down build, splitting at the median centroid along the longest axis
+// of the centroid bounds. The two children of a node are always stored
+// next to each other.
+void TriangleBVH::BuildNode(int index, std::vector<int32_t>& order, const std::vector<float>& centroids, int begin, int end)
+{
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    float clo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, chi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int i = begin; i < end; i++)
+    {
+        const float* tri = &this->triangles[9*order[i]];
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = std::min(lo[k], std::min(tri[k], std::min(tri[3+k], tri[6+k])));
+            hi[k] = std::max(hi[k], std::max(tri[k], std::max(tri[3+k], tri[6+k])));
+            clo[k] = std::min(clo[k], centroids[3*order[i]+k]);
+            chi[k] = std::max(chi[k], centroids[3*order[i]+k]);
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        this->nodes[index].lo[k] = lo[k];
+        this->nodes[index].hi[k] = hi[k];
+    }
+
+    if (end - begin <= BVH_LEAF_SIZE)
+    {
+        this->nodes[index].first = begin;
+        this->nodes[index].count = end - begin;
+        return;
+    }
+
+    int axis = 0;
+    for (int k = 1; k < 3; k++)
+        if (chi[k] - clo[k] > chi[axis] - clo[axis])
+            axis = k;
+
+    int mid = (begin + end)/2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+        [&centroids, axis](int32_t a, int32_t b) { return centroids[3*a+axis] < centroids[3*b+axis]; });
+
+    int left = this->nodes.size();
+    this->nodes.push_back(node());
+    this->nodes.push_back(node());
+    this->nodes[index].first = left;
+    this->nodes[index].count = 0;
+
+    this->BuildNode(left, order, centroids, begin, mid);
+    this->BuildNode(left + 1, order, centroids, mid, end);
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Slab test of the segment against a node's box, limited to [0, maxT]
+bool TriangleBVH::SegmentHitsBox(const float* lo, const float* hi, const double* origin, const double* invDir, double maxT)
+{
+    double tmin = 0, tmax = maxT;
+    for (int k = 0; k < 3; k++)
+    {
+        double t0 = (lo[k] - origin[k])*invDir[k];
+        double t1 = (hi[k] - origin[k])*invDir[k];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if (tmin > tmax)
+            return false;
+    }
+    return true;
+}
+
+// Moller-Trumbore, both sides of the triangle count
+static bool hitsTriangle(const float* tri, const double* origin, const double* dir, double* t, double* normal)
+{
+    double e1[3], e2[3], p[3], q[3], s[3];
+    for (int k = 0; k < 3; k++)
+    {
+        e1[k] = tri[3+k] - tri[k];
+        e2[k] = tri[6+k] - tri[k];
+        s[k] = origin[k] - tri[k];
+    }
+
+    p[0] = dir[1]*e2[2] - dir[2]*e2[1];
+    p[1] = dir[2]*e2[0] - dir[0]*e2[2];
+    p[2] = dir[0]*e2[1] - dir[1]*e2[0];
+    double det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+    if (fabs(det) < 1e-20)
+        return false;
+
+    double invDet = 1/det;
+    double u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2])*invDet;
+    if (u < 0 || u > 1)
+        return false;
+
+    q[0] = s[1]*e1[2] - s[2]*e1[1];
+    q[1] = s[2]*e1[0] - s[0]*e1[2];
+    q[2] = s[0]*e1[1] - s[1]*e1[0];
+    double v = (dir[0]*q[0] + dir[1]*q[1] + dir[2]*q[2])*invDet;
+    if (v < 0 || u + v > 1)
+        return false;
+
+    *t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])*invDet;
+    normal[0] = e1[1]*e2[2] - e1[2]*e2[1];
+    normal[1] = e1[2]*e2[0] - e1[0]*e2[2];
+    normal[2] = e1[0]*e2[1] - e1[1]*e2[0];
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+bvh_raycast TriangleBVH::Raycast(const double* origin, const double* dir, double maxT, double* t, double* normal, int* budget) const
+{
+    if (this->nodes.empty())
+        return BVH_MISS;
+
+    double invDir[3];
+    for (int k = 0; k < 3; k++)
+        invDir[k] = dir[k] != 0 ? 1/dir[k] : (dir[k] < 0 ? -DBL_MAX : DBL_MAX);
+
+    bool hit = false;
+    bool complete = true;
+    double best = maxT;
+    int stack[BVH_STACK_SIZE];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0)
+    {
+        if (*budget <= 0)
+        {
+            complete = false;
+            break;
+        }
+        const node& n = this->nodes[stack[--sp]];
+        (*budget)--;
+
+        if (!TriangleBVH::SegmentHitsBox(n.lo, n.hi, origin, invDir, best))
+            continue;
+
+        if (n.count > 0)
+        {
+            for (int i = n.first; i < n.first + n.count; i++)
+            {
+                double ti, ni[3];
+                if (hitsTriangle(&this->triangles[9*i], origin, dir, &ti, ni) && ti >= 0 && ti <= best)
+                {
+                    best = ti;
+                    normal[0] = ni[0];
+                    normal[1] = ni[1];
+                    normal[2] = ni[2];
+                    hit = true;
+                }
+            }
+        }
+        else if (sp + 2 <= BVH_STACK_SIZE)
+        {
+            stack[sp++] = n.first + 1;
+            stack[sp++] = n.first;
+        }
+        else
+            complete = false;
+    }
+
+    if (hit)
+        *t = best;
+    return !complete ? BVH_UNKNOWN : hit ? BVH_HIT : BVH_MISS;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Closest point on a triangle, from Ericson, Real-Time Collision Detection
+static double distanceToTriangle(const float* tri, const double* p)
+{
+    double a[3], ab[3], ac[3], ap[3];
+    for (int k = 0; k < 3; k++)
+    {
+        a[k] = tri[k];
+        ab[k] = tri[3+k] - tri[k];
+        ac[k] = tri[6+k] - tri[k];
+        ap[k] = p[k] - tri[k];
+    }
+
+    double d1 = ab[0]*ap[0] + ab[1]*ap[1] + ab[2]*ap[2];
+    double d2 = ac[0]*ap[0] + ac[1]*ap[1] + ac[2]*ap[2];
+    double closest[3];
+    double v, w;
+
+    double bp[3], cp[3];
+    for (int k = 0; k < 3; k++)
+    {
+        bp[k] = p[k] - tri[3+k];
+        cp[k] = p[k] - tri[6+k];
+    }
+    double d3 = ab[0]*bp[0] + ab[1]*bp[1] + ab[2]*bp[2];
+    double d4 = ac[0]*bp[0] + ac[1]*bp[1] + ac[2]*bp[2];
+    double d5 = ab[0]*cp[0] + ab[1]*cp[1] + ab[2]*cp[2];
+    double d6 = ac[0]*cp[0] + ac[1]*cp[1] + ac[2]*cp[2];
+    double va = d3*d6 - d5*d4;
+    double vb = d5*d2 - d1*d6;
+    double vc = d1*d4 - d3*d2;
+
+    if (d1 <= 0 && d2 <= 0)
+        v = 0, w = 0;                                   // vertex a
+    else if (d3 >= 0 && d4 <= d3)
+        v = 1, w = 0;                                   // vertex b
+    else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+        v = d1/(d1 - d3), w = 0;                        // edge ab
+    else if (d6 >= 0 && d5 <= d6)
+        v = 0, w = 1;                                   // vertex c
+    else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+        v = 0, w = d2/(d2 - d6);                        // edge ac
+    else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+    {
+        w = (d4 - d3)/((d4 - d3) + (d5 - d6));          // edge bc
+        v = 1 - w;
+    }
+    else
+    {
+        double denom = 1/(va + vb + vc);                // inside the face
+        v = vb*denom;
+        w = vc*denom;
+    }
+
+    double d = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        closest[k] = a[k] + ab[k]*v + ac[k]*w;
+        d += (p[k] - closest[k])*(p[k] - closest[k]);
+    }
+    return sqrt(d);
+}
+
+// Distance from p to a box, 0 inside
+double TriangleBVH::DistanceToBox(const float* lo, const float* hi, const double* p)
+{
+    double d = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        double e = std::max(std::max(lo[k] - p[k], p[k] - hi[k]), 0.0);
+        d += e*e;
+    }
+    return sqrt(d);
+}
+
+// ----------------------------------------------------------------------------
+double TriangleBVH::Distance(const double* p, double maxDistance, int* budget) const
+{
+    double best = maxDistance;
+    if (this->nodes.empty())
+        return best;
+
+    int stack[BVH_STACK_SIZE];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0)
+    {
+        const node& n = this->nodes[stack[--sp]];
+
+        double boxDistance = TriangleBVH::DistanceToBox(n.lo, n.hi, p);
+        if (boxDistance >= best)
+            continue;
+
+        // Out of budget or stack: whatever is inside the box is at least
+        // this far away
+        if (*budget <= 0)
+        {
+            best = boxDistance;
+            continue;
+        }
+        (*budget)--;
+
+        if (n.count > 0)
+        {
+            for (int i = n.first; i < n.first + n.count; i++)
+                best = std::min(best, distanceToTriangle(&this->triangles[9*i], p));
+        }
+        else if (sp + 2 <= BVH_STACK_SIZE)
+        {
+            // Visit the nearer child first so the other one is more likely pruned
+            const node& l = this->nodes[n.first];
+            const node& r = this->nodes[n.first + 1];
+            bool leftFirst = TriangleBVH::DistanceToBox(l.lo, l.hi, p) <= TriangleBVH::DistanceToBox(r.lo, r.hi, p);
+            stack[sp++] = leftFirst ? n.first + 1 : n.first;
+            stack[sp++] = leftFirst ? n.first : n.first + 1;
+        }
+        else
+            best = boxDistance;
+    }
+
+    return best;
+}
@@ -0,0 +1,91 @@
+#ifndef __TRIANGLEBVH_H__
+#define __TRIANGLEBVH_H__
+
+/*
+Bounding volume hierarchy over a triangle mesh
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Outcome of a raycast. Unknown when the query ran out of its node budget
+// before the segment was fully tested, so a nearer hit may exist.
+enum bvh_raycast {
+    BVH_MISS = 0,
+    BVH_HIT,
+    BVH_UNKNOWN
+};
+
+// ----------------------------------------------------------------------------
+// Description:
+// Static BVH over the triangles of one polydata, in its local coordinates.
+// Immutable once built, so it can be queried from any thread.
+class TriangleBVH {
+public:
+    // 9 floats (3 vertices) per triangle, the vector is consumed
+    void Build(std::vector<float>& triangles);
+
+    // Intersect origin + t*dir for t in [0, maxT]. budget is the number of
+    // nodes that may still be visited. When it runs out before the whole
+    // segment was tested the result is BVH_UNKNOWN. t and normal are only
+    // meaningful for BVH_HIT.
+    bvh_raycast Raycast(const double* origin, const double* dir, double maxT, double* t, double* normal, int* budget) const;
+
+    // Distance from p to the closest triangle, or maxDistance if that is
+    // closer. When the budget runs out the result is a lower bound: the
+    // distance to the boxes that were not visited counts as well.
+    double Distance(const double* p, double maxDistance, int* budget) const;
+
+    // Box tests shared with the scene level
+    static bool SegmentHitsBox(const float* lo, const float* hi, const double* origin, const double* invDir, double maxT);
+    static double DistanceToBox(const float* lo, const float* hi, const double* p);
+
+    const double* GetBounds() const { return this->bounds; }
+    size_t GetNumberOfTriangles() const { return this->triangles.size()/9; }
+
+private:
+    struct node {
+        float lo[3], hi[3];
+        int32_t first;  // leaf: first triangle, otherwise left child (right is first+1)
+        int32_t count;  // triangles in a leaf, 0 for inner nodes
+    };
+
+    void BuildNode(int index, std::vector<int32_t>& order, const std::vector<float>& centroids, int begin, int end);
+
+    std::vector<node> nodes;
+    std::vector<float> triangles;
+    double bounds[6];
+};
+
+#endif
@@ -0,0 +1,262 @@
+/*
+Gamepad forwarding daemon
+
+Reads the local gamepad (or a synthetic one) and streams its state to a
+viewer started with StartRemoteGamepad(). With --listen it acts as the
+receiving end instead and prints the stream statistics, which allows
+testing the whole path over loopback:
+
+    gamepadforward --listen 5555 &
+    gamepadforward --synthetic 127.0.0.1 5555
+
+
+Copyright (C) 2015, SURFsara
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived
+   from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "GamepadHandler.h"
+#include "GamepadStream.h"
+
+#include <algorithm>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+
+static volatile bool running = true;
+
+static void stop(int)
+{
+    running = false;
+}
+
+static void usage()
+{
+    std::cout << "usage: gamepadforward [--synthetic] [--rate hz] [--full seconds] [reader options] host port" << std::endl;
+    std::cout << "       gamepadforward --listen port" << std::endl;
+    std::cout << "       gamepadforward --jitter seconds [--load threads] [reader options]" << std::endl;
+    std::cout << "reader options: [--fifo priority | --nice n] [--cpus n,m,...] [--mlock]" << std::endl;
+}
+
+static double monotonicSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// Keeps one CPU busy until the program stops
+static void burn()
+{
+    volatile double x = 0;
+    while (running)
+        x = x + 1;
+}
+
+// ----------------------------------------------------------------------------
+// Description:
+// Delay between the kernel's event timestamp and the reader thread picking
+// the event up, while load threads keep the CPUs busy. Kernel timestamps
+// are in milliseconds on a clock of their own, so delays are relative to
+// the shortest one seen (the offset the reader maps event times with);
+// the first second is skipped while that offset settles.
+static int measureJitter(const gp_thread_options& options, double seconds, int load)
+{
+    GamepadHandler gamepad;
+    if (!gamepad.IsActive())
+        return 1;
+    gamepad.setThreadOptions(options);
+
+    std::vector<std::thread> burners;
+    for (int i = 0; i < load; i++)
+        burners.push_back(std::thread(burn));
+
+    std::cout << "Measuring for " << seconds << " s with " << load << " load threads, keep moving the sticks" << std::endl;
+
+    std::vector<double> delays;
+    std::vector<gp_axis_sample> samples;
+    double start = monotonicSeconds();
+    while (running && monotonicSeconds() - start < seconds)
+    {
+        usleep(100000);
+        gamepad.getAxisSamples(samples);
+        for (size_t i = 0; i < samples.size(); i++)
+            if (samples[i].delivered - start > 1.0)
+                delays.push_back(1000*(samples[i].delivered - samples[i].time));
+    }
+
+    running = false;
+    for (size_t i = 0; i < burners.size(); i++)
+        burners[i].join();
+
+    if (delays.empty())
+    {
+        std::cout << "No stick events received" << std::endl;
+        return 1;
+    }
+
+    std::sort(delays.begin(), delays.end());
+    double sum = 0;
+    for (size_t i = 0; i < delays.size(); i++)
+        sum += delays[i];
+    const double percentiles[] = { 50, 90, 99, 99.9 };
+    std::cout << delays.size() << " events, delay mean " << sum/delays.size() << " ms";
+    for (int i = 0; i < 4; i++)
+        std::cout << ", p" << percentiles[i] << " " << delays[(size_t)(percentiles[i]/100*(delays.size() - 1))] << " ms";
+    std::cout << ", max " << delays.back() << " ms" << std::endl;
+
+    const double edges[] = { 1, 2, 5, 10, 20, 50 };
+    size_t begin = 0;
+    for (int i = 0; i <= 6; i++)
+    {
+        size_t end = i < 6 ? std::lower_bound(delays.begin(), delays.end(), edges[i]) - delays.begin() : delays.size();
+        if (i == 0)
+            std::cout << "        < " << edges[0] << " ms: ";
+        else if (i < 6)
+            std::cout << "  " << edges[i-1] << " - " << edges[i] << " ms: ";
+        else
+            std::cout << "      >= " << edges[5] << " ms: ";
+        std::cout << end - begin << std::endl;
+        begin = end;
+    }
+    return 0;
+}
+
+static int listenForStream(int port)
+{
+    RemoteGamepad gamepad(port);
+    if (!gamepad.IsActive())
+        return 1;
+
+    // Take the state every millisecond like a fast render loop would,
+    // the latency is measured up to there
+    for (int tick = 1; running; tick++)
+    {
+        usleep(1000);
+        gamepad.getGamepadState();
+        if (tick % 1000 != 0)
+            continue;
+
+        gp_stream_stats s = gamepad.getStats();
+        std::cout << s.packets << " packets (" << s.fullStates << " full), " << s.lost << " lost, " << s.late << " late, "
+                  << s.sessions << " sessions, "
+                  << "jitter " << s.jitter << " ms, latency " << s.latencyMean << " ms (max " << s.latencyMax << " ms)" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool synthetic = false;
+    double rate = 500;
+    double full = 0.25;
+    double jitter = 0;
+    int load = std::thread::hardware_concurrency();
+    gp_thread_options options;
+    int i = 1;
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "--listen") == 0 && i+1 < argc)
+            return listenForStream(atoi(argv[i+1]));
+        else if (strcmp(argv[i], "--synthetic") == 0)
+            synthetic = true;
+        else if (strcmp(argv[i], "--rate") == 0 && i+1 < argc)
+            rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--full") == 0 && i+1 < argc)
+            full = atof(argv[++i]);
+        else if (strcmp(argv[i], "--jitter") == 0 && i+1 < argc)
+            jitter = atof(argv[++i]);
+        else if (strcmp(argv[i], "--load") == 0 && i+1 < argc)
+            load = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fifo") == 0 && i+1 < argc)
+        {
+            options.policy = SCHED_FIFO;
+            options.priority = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--nice") == 0 && i+1 < argc)
+            options.nice = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cpus") == 0 && i+1 < argc)
+            options.setCpus(argv[++i]);
+        else if (strcmp(argv[i], "--mlock") == 0)
+            options.lockMemory = true;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (jitter > 0 && i == argc)
+        return measureJitter(options, jitter, load);
+
+    if (argc - i != 2 || rate <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    GamepadStreamSender sender;
+    sender.fullInterval = full;
+    if (!sender.Open(argv[i], atoi(argv[i+1])))
+        return 1;
+
+    GamepadSource* gamepad;
+    if (synthetic)
+        gamepad = new SyntheticGamepad();
+    else
+    {
+        GamepadHandler* handler = new GamepadHandler();
+        handler->setThreadOptions(options);
+        gamepad = handler;
+    }
+
+    if (!gamepad->IsActive())
+    {
+        delete gamepad;
+        return 1;
+    }
+
+    std::vector<gp_axis_sample> samples;
+    while (running)
+    {
+        gamepad->getAxisSamples(samples);
+        sender.SendSamples(samples);
+        sender.Send(gamepad->getGamepadState());
+        usleep(1000000/rate);
+    }
+
+    std::cout << sender.packetsSent << " packets sent" << std::endl;
+    delete gamepad;
+    return 0;
+}
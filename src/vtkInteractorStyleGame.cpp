@@ -17,51 +17,280 @@
 
 #include "vtkCamera.h"
 #include "vtkCallbackCommand.h"
+#include "vtkCullerCollection.h"
+#include "vtkDoubleArray.h"
 #include "vtkMath.h"
+#include "vtkMatrix4x4.h"
+#include "vtkLooseGridCuller.h"
 #include "vtkObjectFactory.h"
 #include "vtkRenderWindow.h"
 #include "vtkRenderWindowInteractor.h"
-#include "vtkXOpenGLRenderWindow.h"
 #include "vtkRenderer.h"
 #include <vtkSmartPointer.h>
 #include <math.h>
+#include <string.h>
 #include <vtkTransform.h>
 
+#ifdef GAMEPAD_USE_X11
+#include "vtkXOpenGLRenderWindow.h"
+
+// The X11 pointer capture asks this for the display and window on every
+// use, they change when VTK recreates the window
+class vtkX11WindowSource : public X11WindowSource
+{
+public:
+  vtkX11WindowSource(vtkXOpenGLRenderWindow *window) : Window(window) { window->Register(NULL); }
+  ~vtkX11WindowSource() { this->Window->UnRegister(NULL); }
+  void* GetDisplay() { return this->Window->GetDisplayId(); }
+  unsigned long GetWindow() { return this->Window->GetWindowId(); }
+
+private:
+  vtkXOpenGLRenderWindow *Window;
+};
+#endif
+
+// Scene queries of the navigation, answered from the style's BVH and
+// clearance field
+class vtkGameNavigationScene : public NavigationScene
+{
+public:
+  vtkGameNavigationScene(vtkInteractorStyleGame *style) : Style(style) {}
+  double Collide(const double *from, double *motion) { return this->Style->CollideMotion(from, motion); }
+  double SpeedScale(const double *position) { return this->Style->SpeedScaleAt(position); }
+
+private:
+  vtkInteractorStyleGame *Style;
+};
+
 vtkStandardNewMacro(vtkInteractorStyleGame);
 
+//----------------------------------------------------------------------------
+// Wall clock for tick times: clock() counts CPU time of the process,
+// which stands still while the viewer waits for vsync or events
+static double monotonicSeconds()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Pick the pointer capture backend matching the render window. Only an
+// on-screen X11 window can have its pointer grabbed or warped, everything
+// else (offscreen, EGL, OSMesa, other window systems) gets the warp-free
+// backend. NULL when the window has not been created yet.
+static PointerCapture* createPointerCapture(vtkRenderWindow *rw)
+{
+  if (rw == NULL)
+    return NULL;
+
+#ifdef GAMEPAD_USE_X11
+  vtkXOpenGLRenderWindow *xrw = vtkXOpenGLRenderWindow::SafeDownCast(rw);
+  if (xrw != NULL && !rw->GetOffScreenRendering())
+    return PointerCapture::CreateX11(new vtkX11WindowSource(xrw));
+#endif
+
+  return new OffscreenPointerCapture();
+}
+
+static void getCameraPose(vtkCamera *camera, nav_pose *pose)
+{
+  camera->GetPosition(pose->position);
+  camera->GetFocalPoint(pose->focalPoint);
+  camera->GetViewUp(pose->viewUp);
+}
+
+static void setCameraPose(vtkCamera *camera, const nav_pose *pose)
+{
+  camera->SetPosition(pose->position[0], pose->position[1], pose->position[2]);
+  camera->SetFocalPoint(pose->focalPoint[0], pose->focalPoint[1], pose->focalPoint[2]);
+  camera->SetViewUp(pose->viewUp[0], pose->viewUp[1], pose->viewUp[2]);
+}
+
 //----------------------------------------------------------------------------
 vtkInteractorStyleGame::vtkInteractorStyleGame()
 {
-  this->maxSpeed = 1;
-  this->gamepadLookSpeed = 20;
   this->mouseLookSpeed = 45;
   this->keyPressedDown = false;
-  this->t = clock();
+  this->t = monotonicSeconds();
   this->mousedt.x = 0;
   this->mousedt.y = 0;
-  this->gamepaddt.x = 0;
-  this->gamepaddt.y = 0;
   this->gamepad = new GamepadHandler();
-  this->gamepadSpeed.x = 0;
-  this->gamepadSpeed.y = 0;
-  this->keyboardSpeed.x = 0;
-  this->keyboardSpeed.y = 0;
-  this->gamepadRoll = 0;
-  this->keyboardRoll = 0;
+  this->axisIntegrator = new AxisIntegrator();
+  this->GamepadDeadzone = 0.0;
+  this->GamepadResponseExponent = 1.0;
+  this->GamepadThreadPriority = 0;
+  this->GamepadThreadNice = 0;
+  this->GamepadThreadMemoryLock = 0;
+  this->InterruptibleRendering = 0;
+  this->AbortInputThreshold = 0.1;
+  this->MaxAbortedFrames = 3;
+  this->abortWindow = NULL;
+  this->renderCallback = vtkCallbackCommand::New();
+  this->renderCallback->SetCallback(vtkInteractorStyleGame::RenderCallback);
+  this->renderCallback->SetClientData(this);
+  this->prefetcher = NULL;
+  this->PrefetchHorizon = 0.3;
+  this->PrefetchDistance = 0.0;
+  this->recorder = NULL;
+  this->recordSwapDeferred = false;
+  this->RecordFilePattern = NULL;
+  this->SetRecordFilePattern("frame%05d.png");
+  this->RecordFrameRate = 30.0;
+  this->RecordDropFrames = 0;
+  this->recordBuffer = -1;
+  this->recordFrameDue = false;
+  this->cameraCommands = new CameraCommandQueue();
+  this->pointerCapture = NULL;
   this->advancedSettings = false;
   this->rotate = false;
-  this->flying = false;
-  this->turntableMode = false;
-  this->modeButtonDown = false;
   this->modelProp3D = NULL;
   this->modelRotation = 0.0;
   this->modelRotateSpeed = 0.0;
+  this->CoalesceInteractionEvents = 1;
+  this->pendingChanges = 0;
+  for (int i = 0; i < 6; i++)
+    this->InteractionSummary[i] = 0.0;
+  this->cameraLeader = NULL;
+  this->cameraFollower = NULL;
+  this->TileOffset[0] = 0.0;
+  this->TileOffset[1] = 0.0;
+  this->FramePacingFollowers = 0;
+  this->FramePacingTimeout = 5.0;
+  this->followerFramePending = false;
+  this->sharedState = NULL;
+  this->sharedStateFrame = 0;
+  this->Collision = 0;
+  this->CollisionRadius = 0.05;
+  this->sceneBVH = NULL;
+  this->AutoSpeed = 0;
+  this->AutoSpeedDistance = 1.0;
+  this->AutoSpeedRange[0] = 0.01;
+  this->AutoSpeedRange[1] = 100.0;
+  this->clearanceField = NULL;
+  this->Picking = 1;
+  this->scenePicker = NULL;
+  this->pickButtonDown = false;
+  this->Culling = 0;
+  this->culler = NULL;
+  this->cullRenderer = NULL;
 }
 
 //----------------------------------------------------------------------------
 vtkInteractorStyleGame::~vtkInteractorStyleGame()
 {
+  this->WatchRenderWindow(NULL);
+  this->CullRenderer(NULL);
+  if (this->culler != NULL)
+    this->culler->Delete();
+  this->renderCallback->Delete();
   delete this->gamepad;
+  delete this->axisIntegrator;
+  delete this->pointerCapture;
+  this->StopCameraSync();
+  this->StopSharedStateExport();
+  this->StopPrefetch();
+  this->StopRecording();
+  this->SetRecordFilePattern(NULL);
+  this->DropCameraCommands(false);
+  delete this->cameraCommands;
+  delete this->clearanceField;
+  delete this->scenePicker;
+  delete this->sceneBVH;
+}
+
+//----------------------------------------------------------------------------
+void vtkInteractorStyleGame::SetGamepadSource(GamepadSource *source)
+{
+  if (source == this->gamepad)
+    return;
+  delete this->gamepad;
+  this->gamepad = source;
+  *this->axisIntegrator = AxisIntegrator();
+  if (this->GamepadThreadPriority > 0 || this->GamepadThreadNice != 0 || !this->GamepadThreadCPUs.empty() ||
+      this->GamepadThreadMemoryLock)
+    this->ApplyGamepadThreadOptions();
+}
+
+//----------------------------------------------------------------------------
+void vtkInteractorStyleGame::SetGamepadThreadPriority(int priority)
+{
+  this->GamepadThreadPriority = std::max(priority, 0);
+  this->ApplyGamepadThreadOptions();
+}
+
+void vtkInteractorStyleGame::SetGamepadThreadNice(int nice)
+{
+  this->GamepadThreadNice = std::min(std::max(nice, -20), 19);
+  this->ApplyGamepadThreadOptions();
+}
+
+void vtkInteractorStyleGame::SetGamepadThreadCPUs(const char *cpus)
+{
+  this->GamepadThreadCPUs = cpus != NULL ? cpus : "";
+  this->ApplyGamepadThreadOptions();
+}
+
+void vtkInteractorStyleGame::SetGamepadThreadMemoryLock(int lock)
+{
+  this->GamepadThreadMemoryLock = lock;
+  this->ApplyGamepadThreadOptions();
+}
+
+// Only a local device has a reader thread, other sources ignore this
+bool vtkInteractorStyleGame::ApplyGamepadThreadOptions()
+{
+  GamepadHandler *handler = dynamic_cast<GamepadHandler*>(this->gamepad);
+  if (handler == NULL)
+    return false;
+
+  gp_thread_options options;
+  if (this->GamepadThreadPriority > 0)
+  {
+    options.policy = SCHED_FIFO;
+    options.priority = this->GamepadThreadPriority;
+  }
+  options.nice = this->GamepadThreadNice;
+  options.setCpus(this->GamepadThreadCPUs.c_str());
+  options.lockMemory = this->GamepadThreadMemoryLock != 0;
+  this->Modified();
+  return handler->setThreadOptions(options);
+}
+
+bool vtkInteractorStyleGame::StartRemoteGamepad(int port)
+{
+  RemoteGamepad *remote = new RemoteGamepad(port);
+  if (!remote->IsActive())
+  {
+    delete remote;
+    return false;
+  }
+  this->SetGamepadSource(remote);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Replace the pointer capture backend, e.g. with an InjectedPointerCapture
+// for tests. The style takes ownership of the backend.
+void vtkInteractorStyleGame::SetPointerCapture(PointerCapture *capture)
+{
+  if (capture == this->pointerCapture)
+    return;
+  delete this->pointerCapture;
+  this->pointerCapture = capture;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Returns the pointer capture backend, creating the one matching the
+// render window on first use. NULL while the window does not exist yet.
+PointerCapture* vtkInteractorStyleGame::GetPointerCapture()
+{
+  if (this->pointerCapture == NULL && this->Interactor != NULL)
+    this->pointerCapture = createPointerCapture(this->Interactor->GetRenderWindow());
+  return this->pointerCapture;
 }
 
 void vtkInteractorStyleGame::SetModelProp3D(vtkProp3D *prop)
@@ -78,25 +307,23 @@ void vtkInteractorStyleGame::OnMouseMove()
     return;
   }
 
-  vtkRenderWindowInteractor *rwi = this->Interactor;
-  vtkXOpenGLRenderWindow *rw = static_cast<vtkXOpenGLRenderWindow *>(rwi->GetRenderWindow());
-  int *size = rw->GetSize();
-  int *eventPos = rwi->GetEventPosition();
+  PointerCapture *capture = this->GetPointerCapture();
+  if (capture == NULL){
+    return;
+  }
 
-  Window Win = rw->GetWindowId();
-  Display* Disp = rw->GetDisplayId();
+  vtkRenderWindowInteractor *rwi = this->Interactor;
+  int *size = rwi->GetRenderWindow()->GetSize();
+  double delta[2] = {0, 0};
 
-  if(eventPos[0] < size[0] && eventPos[1] < size[1]){
-    mousedt.x += rwi->GetEventPosition()[0] - roundl(size[0]/2);
-    mousedt.y += (rwi->GetEventPosition()[1] +1) - roundl(size[1]/2);
+  if(capture->Motion(rwi->GetEventPosition(), size, delta)){
+    mousedt.x += delta[0];
+    mousedt.y += delta[1];
   }
   else{
     mousedt.x = 0;
     mousedt.y = 0;
   }
-
-  // Warp mouse to center of screen to grap the mouse
-  XWarpPointer(Disp, Win, Win, 0,0,size[0],size[1], roundl(size[0]/2), roundl(size[1]/2));
 }
 
 void vtkInteractorStyleGame::OnKeyPress()
@@ -104,8 +331,27 @@ void vtkInteractorStyleGame::OnKeyPress()
   // Get the keypress
   vtkRenderWindowInteractor *rwi = this->Interactor;
   std::string key = rwi->GetKeySym();
+
+  // X11 auto-repeat sends a release and a press for every repeat, the
+  // key was never let go. The repeat still steps the speed and view
+  // angle keys, but only reports what it changed.
+  if (key == this->releasedKey)
+    {
+    this->releasedKey.clear();
+    int pending = this->pendingChanges;
+    this->pendingChanges = 0;
+    this->HandleKeys(key, true);
+    int changed = this->pendingChanges;
+    this->pendingChanges |= pending;
+    if (changed != 0 && !this->CoalesceInteractionEvents)
+      this->InvokeEvent(vtkCommand::InteractionEvent, NULL);
+    return;
+    }
+  this->FlushKeyRelease();
+
   this->HandleKeys(key, true);
-  this->InvokeEvent(vtkCommand::InteractionEvent, NULL);
+  if (!this->CoalesceInteractionEvents)
+    this->InvokeEvent(vtkCommand::InteractionEvent, NULL);
 }
 
 
@@ -114,38 +360,74 @@ void vtkInteractorStyleGame::OnKeyRelease()
   // Get the keypress
   vtkRenderWindowInteractor *rwi = this->Interactor;
   std::string key = rwi->GetKeySym();
-  std::cout << key << std::endl;
+
+  // Handled by the next key press or timer tick, unless it turns out to
+  // be half of an auto-repeat pair
+  this->FlushKeyRelease();
+  this->releasedKey = key;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Handle a held back key release. The press of an auto-repeat pair is
+// queued together with the release, so it is always seen before the next
+// timer tick.
+void vtkInteractorStyleGame::FlushKeyRelease()
+{
+  if (this->releasedKey.empty())
+    return;
+
+  std::string key = this->releasedKey;
+  this->releasedKey.clear();
   this->HandleKeys(key, false);
-  this->InvokeEvent(vtkCommand::InteractionEvent, NULL);
+  if (!this->CoalesceInteractionEvents)
+    this->InvokeEvent(vtkCommand::InteractionEvent, NULL);
 }
 
 void vtkInteractorStyleGame::HandleKeys(std::string key, bool down)
 {
   vtkRenderWindowInteractor *rwi = this->Interactor;
+
+  int navKey = 0;
   if (key == "w")
-    this->keyboardSpeed.y = down ? this->maxSpeed: 0.0;
+    navKey = NAV_KEY_W;
   else if (key == "a")
-    this->keyboardSpeed.x = down ? -this->maxSpeed : 0.0;
+    navKey = NAV_KEY_A;
   else if (key == "s")
-    this->keyboardSpeed.y = down ? -this->maxSpeed : 0.0;
+    navKey = NAV_KEY_S;
   else if (key == "d")
-    this->keyboardSpeed.x = down ? this->maxSpeed : 0.0;
+    navKey = NAV_KEY_D;
   else if (key == "q")
-    this->keyboardRoll = down ? this->gamepadLookSpeed: 0.0;
+    navKey = NAV_KEY_Q;
   else if (key == "e")
-    this->keyboardRoll = down ? -this->gamepadLookSpeed: 0.0;
+    navKey = NAV_KEY_E;
   else if (key== "bracketright")
-    this->maxSpeed = down ? std::min(++this->maxSpeed, 200.0) : this->maxSpeed;
+    navKey = NAV_KEY_BRACKETRIGHT;
   else if (key== "bracketleft")
-    this->maxSpeed = down ? std::max(--this->maxSpeed, 0.0) : this->maxSpeed;
+    navKey = NAV_KEY_BRACKETLEFT;
   else if (key == "Escape")
     rwi->ExitCallback();
+  else if (key == "f" && down)
+  {
+    int *position = rwi->GetEventPosition();
+    this->FlyToPick(position[0], position[1]);
+  }
   else if (key == "KP_5")
     this->advancedSettings = down ? this->advancedSettings : !this->advancedSettings;
   else if (key == "KP_Subtract" && this->advancedSettings)
+  {
     this->CurrentRenderer->GetActiveCamera()->SetViewAngle(this->CurrentRenderer->GetActiveCamera()->GetViewAngle()-1);
+    this->pendingChanges |= ViewAngleChanged;
+  }
   else if (key == "KP_Add" && this->advancedSettings)
+  {
     this->CurrentRenderer->GetActiveCamera()->SetViewAngle(this->CurrentRenderer->GetActiveCamera()->GetViewAngle()+1);
+    this->pendingChanges |= ViewAngleChanged;
+  }
+
+  // Repeated presses of a held key change nothing
+  if (navKey != 0)
+    this->pendingChanges |= this->navigation.HandleKey(navKey, down);
 }
 
 void vtkInteractorStyleGame::OnChar()
@@ -159,6 +441,18 @@ void vtkInteractorStyleGame::OnChar()
       rwi->UserCallback();
       break;
 
+    case 'r' :
+    case 'R' :
+      if (this->recorder != NULL)
+        {
+        this->StopRecording();
+        }
+      else
+        {
+        this->StartRecording();
+        }
+      break;
+
     case '3' :
       if (rwi->GetRenderWindow()->GetStereoRender())
         {
@@ -178,37 +472,115 @@ void vtkInteractorStyleGame::OnChar()
 // Timer set on each render step. Handle mouse, keyboard and gamepad movement and move the camera accordingly.
 void vtkInteractorStyleGame::OnTimer()
 {
+    this->FlushKeyRelease();
+    this->CullRenderer(this->Culling ? this->CurrentRenderer : NULL);
+
+    // A follower only mirrors the leader's camera, so camera commands
+    // fail there. Its renders are watched to acknowledge a pose once it
+    // is on screen.
+    if (this->cameraFollower != NULL)
+    {
+        this->DropCameraCommands(true);
+        this->WatchRenderWindow(this->Interactor->GetRenderWindow());
+        this->FollowCamera();
+        double dt = this->TickTime();
+        if (this->sharedState != NULL)
+            this->ExportSharedState(dt);
+        return;
+    }
+
+    this->ApplyCameraCommands();
+
     vtkRenderWindowInteractor *rwi = this->Interactor;
-    vtkXOpenGLRenderWindow *rw = static_cast<vtkXOpenGLRenderWindow *>(rwi->GetRenderWindow());
-    int *size = rw->GetSize();
-    Window Win = rw->GetWindowId();
-    Display* Disp = rw->GetDisplayId();
+    int *size = rwi->GetRenderWindow()->GetSize();
+    PointerCapture *capture = this->GetPointerCapture();
 
-    if (this->gamepad->IsActive())
+    this->WatchRenderWindow(this->InterruptibleRendering || this->recorder != NULL ? rwi->GetRenderWindow() : NULL);
+
+    if (capture != NULL)
     {
-        // Get updated gamepad state
-        this->handleGamepadState(this->gamepad->getGamepadState());
+        double delta[2] = {0, 0};
+        capture->Poll(delta);
+        mousedt.x += delta[0];
+        mousedt.y += delta[1];
+    }
+
+    // Pick up scene changes, rebuilds happen in the background. Picking
+    // only needs the BVH from the first pick on.
+    bool picking = this->Picking && this->scenePicker != NULL;
+    if ((this->Collision || this->AutoSpeed || picking) && this->CurrentRenderer != NULL)
+    {
+        if (this->sceneBVH == NULL)
+            this->sceneBVH = new SceneBVH();
+        this->sceneBVH->Update(this->CurrentRenderer);
     }
 
-    double dt = ((double)(clock() - t))/CLOCKS_PER_SEC;
-    t = clock();
+    // Start the flight once a fly-to pick came back, stopping at four
+    // fifths of the way to the surface
+    pick_result pick;
+    if (picking && this->sceneBVH != NULL && this->scenePicker->Update(this->sceneBVH, &pick))
+    {
+        if (pick.hit)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                this->navigation.flyFocus[i] = pick.point[i];
+                this->navigation.flyDestination[i] = pick.ray.origin[i] + 0.8*pick.t*pick.ray.direction[i];
+            }
+            this->StartFlight(5);
+        }
+        else
+            std::cout << "Nothing to fly to under the pick position" << std::endl;
+    }
 
-    if(this->gamepadSpeed.y != 0 || this->keyboardSpeed.y != 0)
-        this->MoveToFocalPoint(dt);
-    if(this->gamepadSpeed.x != 0 || this->keyboardSpeed.x != 0)
-        this->Pan(dt);
+    // Keep the clearance grids around the camera up to date for the
+    // speed scale, they are computed in the background
+    if (this->AutoSpeed && this->sceneBVH != NULL && this->CurrentRenderer != NULL)
+    {
+        if (this->clearanceField == NULL)
+            this->clearanceField = new ClearanceField();
+        double position[3];
+        this->CurrentRenderer->GetActiveCamera()->GetPosition(position);
+        this->clearanceField->Update(this->sceneBVH, position);
+    }
 
-    if(this->gamepadRoll != 0 || this->keyboardRoll != 0)
-        this->CameraRoll(dt);
-    if(this->gamepaddt.x !=0)
-        //this->ModelRotate(dt);
-        this->CameraYaw(dt);
-    if(this->gamepaddt.y !=0)
-        this->Up(dt);
-        //this->CameraPitch(dt);
+    if (this->gamepad->IsActive())
+    {
+        // Get updated gamepad state, the sticks as their mean over the
+        // time since the previous tick
+        this->axisIntegrator->deadzone = this->GamepadDeadzone;
+        this->axisIntegrator->exponent = this->GamepadResponseExponent;
+        this->axisIntegrator->Update(this->gamepad);
+        this->handleGamepadState(this->gamepad->getGamepadState());
+    }
 
-    if(this->flying)
-        this->Fly(dt);
+    double dt = this->TickTime();
+    if (this->recorder != NULL)
+        dt = this->RecordStep();
+
+    if (this->CurrentRenderer != NULL)
+    {
+        vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+        nav_pose pose, start;
+        getCameraPose(camera, &pose);
+        start = pose;
+
+        this->navigation.mouseYaw = size[0] > 0 ? -this->mouseLookSpeed / size[0] * mousedt.x : 0.0;
+        vtkGameNavigationScene scene(this);
+        int events = this->navigation.Step(&pose, dt, &scene);
+        this->pendingChanges |= events;
+        if (!this->flightCommands.empty())
+            this->UpdateFlightCommands((events & FlyArrived) != 0);
+
+        if (memcmp(&pose, &start, sizeof(pose)) != 0)
+        {
+            setCameraPose(camera, &pose);
+            if (rwi->GetLightFollowCamera())
+                this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+            if (this->AutoAdjustCameraClippingRange)
+                this->CurrentRenderer->ResetCameraClippingRange();
+        }
+    }
 
     if (this->modelRotateSpeed != 0)
     {
@@ -221,7 +593,239 @@ void vtkInteractorStyleGame::OnTimer()
 
     mousedt.x = 0;
     mousedt.y = 0;
-    XWarpPointer(Disp, Win, Win, 0,0,size[0],size[1], roundl(size[0]/2), roundl(size[1]/2));
+    if (capture != NULL)
+        capture->Recenter(size);
+
+    if (this->cameraLeader != NULL)
+        this->BroadcastCamera();
+
+    if (this->sharedState != NULL)
+        this->ExportSharedState(dt);
+
+    if (this->prefetcher != NULL && this->CurrentRenderer != NULL)
+    {
+        vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+        prefetch_camera motion;
+        camera->GetPosition(motion.position);
+        camera->GetDirectionOfProjection(motion.direction);
+        camera->GetViewUp(motion.viewUp);
+        camera->GetClippingRange(motion.clippingRange);
+        this->GetCameraVelocity(motion.velocity);
+        motion.yawRate = this->GetCameraYawRate();
+        motion.viewAngle = camera->GetViewAngle();
+        motion.aspect = size[1] > 0 ? (double)size[0]/size[1] : 1.0;
+        motion.horizon = this->PrefetchHorizon;
+        motion.step = 0.1;
+        motion.maxDistance = this->PrefetchDistance;
+        this->prefetcher->Update(motion);
+    }
+
+    // Without coalescing the changes were reported by their own events
+    if (this->CoalesceInteractionEvents && this->pendingChanges != 0)
+        this->InvokeInteractionSummary();
+    else
+        this->pendingChanges = 0;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Fire the single InteractionEvent for all changes collected this tick
+void vtkInteractorStyleGame::InvokeInteractionSummary()
+{
+    this->InteractionSummary[0] = this->pendingChanges;
+    this->InteractionSummary[1] = this->navigation.turntableMode;
+    this->InteractionSummary[2] = this->navigation.maxSpeed;
+    this->InteractionSummary[3] = this->navigation.flying;
+    this->InteractionSummary[4] = this->navigation.flyto;
+    this->InteractionSummary[5] = this->CurrentRenderer != NULL ?
+        this->CurrentRenderer->GetActiveCamera()->GetViewAngle() : 0.0;
+    this->pendingChanges = 0;
+
+    this->InvokeEvent(vtkCommand::InteractionEvent, this->InteractionSummary);
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Fly to a bookmark (1-4) or the picked point (5). A flight still under
+// way to another target, or to an earlier pick, is given up.
+void vtkInteractorStyleGame::StartFlight(int target)
+{
+  this->pendingChanges |= this->navigation.StartFlight(target);
+}
+
+//----------------------------------------------------------------------------
+bool vtkInteractorStyleGame::StartCameraBroadcast(const char *group, int port)
+{
+  this->StopCameraSync();
+  this->cameraLeader = new CameraSyncLeader();
+  if (!this->cameraLeader->Open(group, port))
+  {
+    this->StopCameraSync();
+    return false;
+  }
+  return true;
+}
+
+bool vtkInteractorStyleGame::StartCameraFollow(const char *group, int port)
+{
+  this->StopCameraSync();
+  this->cameraFollower = new CameraSyncFollower();
+  if (!this->cameraFollower->Open(group, port))
+  {
+    this->StopCameraSync();
+    return false;
+  }
+  return true;
+}
+
+void vtkInteractorStyleGame::StopCameraSync()
+{
+  delete this->cameraLeader;
+  delete this->cameraFollower;
+  this->cameraLeader = NULL;
+  this->cameraFollower = NULL;
+  this->followerFramePending = false;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Leader side, called at the end of every tick. The pacing wait is
+// bounded, late or lost acknowledgements only cost FramePacingTimeout.
+void vtkInteractorStyleGame::BroadcastCamera()
+{
+  if (this->CurrentRenderer == NULL)
+    return;
+
+  this->cameraLeader->WaitForFollowers(this->FramePacingFollowers, this->FramePacingTimeout);
+
+  camera_sync_packet packet;
+  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+  camera->GetPosition(packet.position);
+  camera->GetFocalPoint(packet.focalPoint);
+  camera->GetViewUp(packet.viewUp);
+  packet.viewAngle = camera->GetViewAngle();
+
+  vtkMatrix4x4 *model = this->modelProp3D != NULL ? this->modelProp3D->GetUserMatrix() : NULL;
+  if (model != NULL)
+    vtkMatrix4x4::DeepCopy(packet.modelTransform, model);
+  else
+    for (int i = 0; i < 16; i++)
+      packet.modelTransform[i] = i % 5 == 0 ? 1.0 : 0.0;
+
+  this->cameraLeader->Publish(&packet);
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Follower side, replaces the navigation of the tick. The pose is
+// acknowledged by RenderCallback() once a frame showing it has been
+// rendered.
+void vtkInteractorStyleGame::FollowCamera()
+{
+  if (this->CurrentRenderer == NULL)
+    return;
+
+  camera_sync_packet packet;
+  if (!this->cameraFollower->Receive(&packet))
+    return;
+  this->followerFramePending = true;
+
+  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+  camera->SetPosition(packet.position);
+  camera->SetFocalPoint(packet.focalPoint);
+  camera->SetViewUp(packet.viewUp);
+  camera->SetViewAngle(packet.viewAngle);
+  camera->SetWindowCenter(this->TileOffset[0], this->TileOffset[1]);
+
+  if (this->modelProp3D != NULL)
+  {
+    vtkSmartPointer<vtkTransform> xform = vtkSmartPointer<vtkTransform>::New();
+    xform->SetMatrix(packet.modelTransform);
+    this->modelProp3D->SetUserTransform(xform.Get());
+  }
+
+  if (this->Interactor->GetLightFollowCamera())
+    this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+  if (this->AutoAdjustCameraClippingRange)
+    this->CurrentRenderer->ResetCameraClippingRange();
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Seconds since the previous tick
+double vtkInteractorStyleGame::TickTime()
+{
+  double now = monotonicSeconds();
+  double dt = now - this->t;
+  this->t = now;
+  return dt;
+}
+
+//----------------------------------------------------------------------------
+bool vtkInteractorStyleGame::StartSharedStateExport(const char *name)
+{
+  this->StopSharedStateExport();
+  this->sharedState = new SharedStateWriter();
+  if (!this->sharedState->Open(name))
+  {
+    this->StopSharedStateExport();
+    return false;
+  }
+  return true;
+}
+
+void vtkInteractorStyleGame::StopSharedStateExport()
+{
+  delete this->sharedState;
+  this->sharedState = NULL;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// Fill in this tick's snapshot and hand it to the seqlock writer
+void vtkInteractorStyleGame::ExportSharedState(double dt)
+{
+  shared_state state;
+  memset(&state, 0, sizeof(state));
+
+  state.frame = ++this->sharedStateFrame;
+  state.time = monotonicSeconds();
+  state.frameTime = dt;
+
+  if (this->CurrentRenderer != NULL)
+  {
+    vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+    camera->GetPosition(state.position);
+    camera->GetFocalPoint(state.focalPoint);
+    camera->GetViewUp(state.viewUp);
+    state.viewAngle = camera->GetViewAngle();
+  }
+
+  state.maxSpeed = this->navigation.maxSpeed;
+  state.gamepadSpeed[0] = this->navigation.gamepadSpeed[0];
+  state.gamepadSpeed[1] = this->navigation.gamepadSpeed[1];
+  state.keyboardSpeed[0] = this->navigation.keyboardSpeed[0];
+  state.keyboardSpeed[1] = this->navigation.keyboardSpeed[1];
+  state.lookSpeed[0] = this->navigation.look[0];
+  state.lookSpeed[1] = this->navigation.look[1];
+  state.flyto = this->navigation.flyto;
+  state.flags = (this->navigation.turntableMode ? SHARED_STATE_TURNTABLE : 0) |
+                (this->navigation.flying ? SHARED_STATE_FLYING : 0) |
+                (this->advancedSettings ? SHARED_STATE_ADVANCED : 0);
+
+  if (this->gamepad->IsActive())
+  {
+    gp_state *gpst = this->gamepad->getGamepadState();
+    state.flags |= SHARED_STATE_GAMEPAD;
+    state.axes = std::min(gpst->axis.size(), (size_t)SHARED_STATE_AXES);
+    state.buttons = std::min(gpst->button.size(), (size_t)SHARED_STATE_BUTTONS);
+    for (uint32_t i = 0; i < state.axes; i++)
+      state.axis[i] = gpst->axis[i];
+    for (uint32_t i = 0; i < state.buttons; i++)
+      state.button[i] = gpst->button[i];
+  }
+
+  this->sharedState->Publish(&state);
 }
 
 //----------------------------------------------------------------------------
@@ -241,77 +845,48 @@ void vtkInteractorStyleGame::handleGamepadState(gp_state* gpst)
         this->Interactor->ExitCallback();
     }
 
-    // Button 9: mode switch
-    if (gpst->button[8])
+    // Sticks, d-pad, fly targets and the mode switch (button 9)
+    int buttons = 0;
+    for (size_t i = 0; i < gpst->button.size() && i < 31; i++)
+      if (gpst->button[i])
+        buttons |= 1 << i;
+    double sticks[4], dpad[3];
+    for (int i = 0; i < 4; i++)
+      sticks[i] = this->axisIntegrator->GetAxis(i);
+    for (int i = 0; i < 3; i++)
+      dpad[i] = 4 + i < (int)gpst->axis.size() ? gpst->axis[4 + i] : 0;
+    int events = this->navigation.HandleGamepad(sticks, dpad, buttons);
+    if (events & ModeChanged)
+      printf("Switched to %s mode\n", this->navigation.turntableMode ? "turntable" : "game");
+    this->pendingChanges |= events;
+
+    if (!this->navigation.turntableMode)
     {
-      if (!this->modeButtonDown)
+      // Button 11: fly to the surface in the middle of the window
+      if (gpst->button[10])
       {
-        this->turntableMode = !this->turntableMode;
-        printf("Switched to %s mode\n", this->turntableMode ? "turntable" : "game");
-        this->modeButtonDown = true;
-      }
-    }
-    else
-      this->modeButtonDown = false;
-
-    if (this->turntableMode)
-    {
-      // Left analog stick movement which controls the movement speed.
-      this->gamepadSpeed.x = (((double)gpst->axis[0])/32767)*this->maxSpeed;
-      this->gamepadSpeed.y = -(((double)gpst->axis[1])/32767)*this->maxSpeed;
-
-      // Right analog stick movement controls
-    }
-    else
-    {
-      // Game mode (strafe, fly, ...)
-      if(gpst->button[0]){
-         this->flyto = 1;
-         this->flying = true;
-      }
-      if(gpst->button[1]) {
-        this->flyto = 2;
-        this->flying = true;
-      }
-      if(gpst->button[2]) {
-        this->flyto = 3;
-        this->flying = true;
-      }
-      if(gpst->button[3]){
-        this->flyto = 4;
-        this->flying = true;
+        if (!this->pickButtonDown)
+        {
+          int *size = this->Interactor->GetRenderWindow()->GetSize();
+          this->FlyToPick(size[0]/2, size[1]/2);
+          this->pickButtonDown = true;
+        }
       }
+      else
+        this->pickButtonDown = false;
 
       if(gpst->button[9])
           this->rotate = true;
       else
           this->rotate = false;
 
-      // Left analog stick: movement which controls the movement speed.
-      this->gamepadSpeed.x = (((double)gpst->axis[0])/32767)*this->maxSpeed;
-      this->gamepadSpeed.y = -(((double)gpst->axis[1])/32767)*this->maxSpeed;
-
-      // Right analog stick: controls the looking speed
-      this->gamepaddt.x = -(((double)gpst->axis[2])/32767);
-      this->gamepaddt.y = -(((double)gpst->axis[3])/32767);
-
-      // Overwrite analog stick if arrows are pushed
-      if(gpst->axis[4]){
-        this->gamepadSpeed.x = (((double)gpst->axis[5])/32767) * this->maxSpeed;
-      }
-      else if(gpst->axis[5]){
-        this->gamepadSpeed.x = -(((double)gpst->axis[6])/32767) * this->maxSpeed;
-      }
-      else
-        this->modelRotateSpeed = 0.0;
-
       // The shoulder buttons control the roll of the camera
       if (gpst->button[4] && gpst->button[5])
           this->modelRotateSpeed = 0;
       else if (gpst->button[4])
-          this->modelRotateSpeed = -this->maxSpeed;
+          this->modelRotateSpeed = -this->navigation.maxSpeed;
       else if(gpst->button[5])
-          this->modelRotateSpeed = this->maxSpeed;
+          this->modelRotateSpeed = this->navigation.maxSpeed;
       else
           this->modelRotateSpeed = 0;
     }
@@ -347,10 +922,11 @@ void vtkInteractorStyleGame::ModelRotate(double dt)
 
 //----------------------------------------------------------------------------
 // Discription:
-// Called every timestep from ontimer to yaw the camera based on the mouse, keyboard and gamepad movement.
-void vtkInteractorStyleGame::CameraYaw(double dt)
+// Called every timestep from ontimer to pitch the camera based on the mouse, keyboard and gamepad movement.
+void vtkInteractorStyleGame::CameraPitch(double dt)
 {
-  if (this->CurrentRenderer == NULL){
+  if (this->CurrentRenderer == NULL)
+  {
     return;
   }
 
@@ -358,13 +934,13 @@ void vtkInteractorStyleGame::CameraYaw(double dt)
 
   vtkRenderWindowInteractor *rwi = this->Interactor;
 
-  double delta_Yaw = -this->mouseLookSpeed / size[0];
-  double mouseyaw = mousedt.x * delta_Yaw;
+  double delta_Pitch = this->mouseLookSpeed / size[1];
+  double mousePitch = mousedt.y * delta_Pitch;
 
-  double gamepadYaw = gamepaddt.x*this->gamepadLookSpeed*dt;
+  double gamepadPitch = this->navigation.look[1]*this->navigation.gamepadLookSpeed*dt;
 
   vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
-  camera->Yaw(mouseyaw + gamepadYaw);
+  camera->Pitch(mousePitch + gamepadPitch);
   camera->OrthogonalizeViewUp();
 
   if (this->AutoAdjustCameraClippingRange)
@@ -374,278 +950,612 @@ void vtkInteractorStyleGame::CameraYaw(double dt)
 }
 
 //----------------------------------------------------------------------------
-// Discription:
-// Called every timestep from ontimer to pitch the camera based on the mouse, keyboard and gamepad movement.
-void vtkInteractorStyleGame::CameraPitch(double dt)
+void vtkInteractorStyleGame::SimulateNavigation(vtkDoubleArray *input, vtkDoubleArray *output)
 {
-  if (this->CurrentRenderer == NULL)
-  {
+  if (input == NULL || output == NULL)
+    {
     return;
-  }
+    }
+  if (input->GetNumberOfComponents() != NAV_SAMPLE_SIZE)
+    {
+    vtkErrorMacro(<< "Expected " << NAV_SAMPLE_SIZE << " components per input sample, got "
+                  << input->GetNumberOfComponents());
+    return;
+    }
 
-  int *size = this->CurrentRenderer->GetRenderWindow()->GetSize();
+  nav_pose pose = { {0, 0, 1}, {0, 0, 0}, {0, 1, 0} };
+  if (this->CurrentRenderer != NULL)
+    {
+    getCameraPose(this->CurrentRenderer->GetActiveCamera(), &pose);
+    }
 
-  vtkRenderWindowInteractor *rwi = this->Interactor;
+  // A copy, so the style's speeds and flight are left as they are
+  NavigationIntegrator integrator = this->navigation;
+  integrator.deadzone = this->GamepadDeadzone;
+  integrator.responseExponent = this->GamepadResponseExponent;
+  integrator.mouseYaw = 0;
+  vtkGameNavigationScene scene(this);
 
-  double delta_Pitch = this->mouseLookSpeed / size[1];
-  double mousePitch = mousedt.y * delta_Pitch;
+  vtkIdType n = input->GetNumberOfTuples();
+  output->SetNumberOfComponents(9);
+  output->SetNumberOfTuples(n);
 
-  double gamepadPitch = gamepaddt.y*this->gamepadLookSpeed*dt;
+  // Sample i-1 is held over [t(i-1), t(i)], the first output is the
+  // starting pose
+  const double *in = input->GetPointer(0);
+  double *out = output->GetPointer(0);
 
-  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
-  camera->Pitch(mousePitch + gamepadPitch);
-  camera->OrthogonalizeViewUp();
+  for (vtkIdType i = 0; i < n; i++, in += NAV_SAMPLE_SIZE, out += 9)
+    {
+    if (i > 0)
+      {
+      const double *previous = in - NAV_SAMPLE_SIZE;
+      integrator.ApplySample(previous);
+      integrator.Step(&pose, in[NAV_TIME] - previous[NAV_TIME], &scene);
+      }
 
-  if (this->AutoAdjustCameraClippingRange)
-  {
-    this->CurrentRenderer->ResetCameraClippingRange();
-  }
+    for (int j = 0; j < 3; j++)
+      {
+      out[j] = pose.position[j];
+      out[3+j] = pose.focalPoint[j];
+      out[6+j] = pose.viewUp[j];
+      }
+    }
 }
 
 //----------------------------------------------------------------------------
-// Discription:
-// Called every timestep from ontimer to roll the camera based on the mouse, keyboard and gamepad movement.
-void vtkInteractorStyleGame::CameraRoll(double dt)
+// Description:
+// Collision mode: the motion of the camera at from is swept against the
+// scene BVH. The camera stops CollisionRadius in front of a surface and
+// the rest of the motion slides along it, a few iterations handle
+// corners. The swept ray only follows the center of the camera, so every
+// step is also checked for clearance at its end: a slide grazing a
+// surface with the side of the sphere is cut back to where the camera
+// keeps its radius (or the clearance it started with, when that was
+// less). A query that runs out of budget blocks the rest of the motion.
+// Returns the fraction of the requested distance that is left in motion.
+double vtkInteractorStyleGame::CollideMotion(const double *from, double *motion)
 {
-  if (this->CurrentRenderer == NULL)
-  {
-    return;
-  }
+  double requested = vtkMath::Norm(motion);
+  if (!this->Collision || this->sceneBVH == NULL || requested < 1e-12)
+    return 1.0;
 
-  double roll = (keyboardRoll + gamepadRoll)*dt;
+  double radius = this->CollisionRadius;
+  double position[3] = { from[0], from[1], from[2] };
+  double remaining[3] = { motion[0], motion[1], motion[2] };
+  double total[3] = { 0, 0, 0 };
+  double clearance = std::min(this->sceneBVH->Distance(position, radius), radius);
 
-  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
-  camera->Roll(roll);
-  camera->OrthogonalizeViewUp();
+  for (int i = 0; i < 3; i++)
+    {
+    double length = vtkMath::Norm(remaining);
+    if (length < 1e-12)
+      break;
 
-  if (this->AutoAdjustCameraClippingRange)
-  {
-    this->CurrentRenderer->ResetCameraClippingRange();
-  }
+    // Sweep the camera plus its radius
+    double reach = (length + radius) / length;
+    double sweep[3] = { remaining[0]*reach, remaining[1]*reach, remaining[2]*reach };
+    double t, normal[3];
+    bvh_raycast result = this->sceneBVH->Raycast(position, sweep, &t, normal);
+    if (result == BVH_UNKNOWN)
+      break;
+
+    double allowed = result == BVH_MISS ? 1.0 : std::max(t*(length + radius) - radius, 0.0) / length;
+    double step[3];
+    for (int k = 0; k < 3; k++)
+      step[k] = remaining[k]*allowed;
+
+    // Bisect a step that ends too close to a surface
+    double end[3];
+    vtkMath::Add(position, step, end);
+    bool cut = this->sceneBVH->Distance(end, radius) < clearance;
+    if (cut)
+      {
+      double lo = 0, hi = 1;
+      for (int j = 0; j < 10; j++)
+        {
+        double mid = (lo + hi)/2;
+        for (int k = 0; k < 3; k++)
+          end[k] = position[k] + mid*step[k];
+        if (this->sceneBVH->Distance(end, radius) >= clearance)
+          lo = mid;
+        else
+          hi = mid;
+        }
+      vtkMath::MultiplyScalar(step, lo);
+      }
+
+    vtkMath::Add(total, step, total);
+    vtkMath::Add(position, step, position);
+    vtkMath::Subtract(remaining, step, remaining);
+    if (cut || result == BVH_MISS)
+      break;
+
+    // Keep only the part of the motion along the surface
+    double d = vtkMath::Dot(remaining, normal);
+    for (int k = 0; k < 3; k++)
+      remaining[k] -= d*normal[k];
+    }
+
+  motion[0] = total[0];
+  motion[1] = total[1];
+  motion[2] = total[2];
+  return vtkMath::Norm(total) / requested;
 }
 
 //----------------------------------------------------------------------------
-// Discription:
-// Called every timestep from ontimer to pan the camera based on the mouse, keyboard and gamepad movement.
-void vtkInteractorStyleGame::Pan(double dt)
+void vtkInteractorStyleGame::GetCameraVelocity(double velocity[3])
 {
+  velocity[0] = velocity[1] = velocity[2] = 0.0;
   if (this->CurrentRenderer == NULL)
-    {
     return;
-    }
 
-  vtkRenderWindowInteractor *rwi = this->Interactor;
+  nav_pose pose;
+  getCameraPose(this->CurrentRenderer->GetActiveCamera(), &pose);
+  this->navigation.GetVelocity(&pose, velocity);
+}
+
+double vtkInteractorStyleGame::GetCameraYawRate()
+{
+  return this->navigation.look[0] * this->navigation.gamepadLookSpeed;
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// AutoSpeed factor at position: the clearance there relative to
+// AutoSpeedDistance. Only a lookup, OnTimer() keeps the grids updated.
+double vtkInteractorStyleGame::SpeedScaleAt(const double *position)
+{
+  if (!this->AutoSpeed || this->clearanceField == NULL || this->AutoSpeedDistance <= 0)
+    return 1.0;
+  double clearance = this->clearanceField->Sample(position);
+  if (clearance < 0)
+    return 1.0;
+  return std::min(std::max(clearance / this->AutoSpeedDistance, this->AutoSpeedRange[0]), this->AutoSpeedRange[1]);
+}
 
-  double viewFocus[3], viewPoint[3], viewUp[3];
-  double motionVector[3];
-  double dirOfProjection[3];
-  double motiondelta = 0;
+//----------------------------------------------------------------------------
+bool vtkInteractorStyleGame::StartPrefetch(double memoryMB)
+{
+  this->StopPrefetch();
+  if (memoryMB <= 0)
+    return false;
+  this->prefetcher = new BrickPrefetcher((uint64_t)(memoryMB*1024*1024));
+  return true;
+}
 
-  // Calculate the focal depth since we'll be using it a lot
+void vtkInteractorStyleGame::StopPrefetch()
+{
+  delete this->prefetcher;
+  this->prefetcher = NULL;
+}
 
-  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+//----------------------------------------------------------------------------
+bool vtkInteractorStyleGame::StartRecording()
+{
+  this->StopRecording();
+  if (!FrameRecorder::ValidPattern(this->RecordFilePattern))
+    {
+    vtkErrorMacro(<< "RecordFilePattern needs exactly one integer conversion for the frame number: "
+                  << (this->RecordFilePattern != NULL ? this->RecordFilePattern : "(null)"));
+    return false;
+    }
+  this->recorder = new FrameRecorder(this->RecordFilePattern);
+  this->recordBuffer = -1;
+  this->recordFrameDue = false;
+  vtkDebugMacro(<< "Recording to " << this->RecordFilePattern);
+  return true;
+}
 
-  double speed = keyboardSpeed.x + gamepadSpeed.x;
-  speed = speed > this->maxSpeed ? this->maxSpeed : speed < -this->maxSpeed ? -this->maxSpeed : speed;
+// Waits for the frames still queued to be written
+void vtkInteractorStyleGame::StopRecording()
+{
+  if (this->recorder == NULL)
+    return;
+  if (this->recordBuffer >= 0)
+    this->recorder->Release(this->recordBuffer);
+  record_stats stats = this->recorder->GetStats();
+  delete this->recorder;
+  this->recorder = NULL;
+  this->recordBuffer = -1;
+  this->recordFrameDue = false;
+  vtkDebugMacro(<< "Recorded " << stats.captured << " frames, " << stats.written << " written, "
+                << stats.failed << " failed");
+}
 
-  motiondelta=dt*speed;
+void vtkInteractorStyleGame::GetRecordStatistics(double stats[5])
+{
+  record_stats s = this->recorder != NULL ? this->recorder->GetStats() : record_stats();
+  stats[0] = s.captured;
+  stats[1] = s.written;
+  stats[2] = s.failed;
+  stats[3] = s.stalls;
+  stats[4] = s.queued;
+}
 
-  camera->GetDirectionOfProjection(dirOfProjection);
-  camera->GetFocalPoint(viewFocus);
-  camera->GetPosition(viewPoint);
-  camera->GetViewUp(viewUp);
+//----------------------------------------------------------------------------
+// Description:
+// Timestep while recording. The camera advances by one frame only once
+// the previous frame was captured and a buffer is free for the next one;
+// with RecordDropFrames it always advances and frames without a buffer
+// are not recorded.
+double vtkInteractorStyleGame::RecordStep()
+{
+  if (this->recordFrameDue && !this->RecordDropFrames)
+    return 0.0;
 
-  vtkMath::Cross(dirOfProjection, viewUp, motionVector);
-  vtkMath::Normalize(motionVector);
+  if (this->recordBuffer < 0)
+    this->recordBuffer = this->recorder->Acquire();
+  if (this->recordBuffer < 0 && !this->RecordDropFrames)
+    return 0.0;
 
-  camera->SetFocalPoint((motionVector[0]*motiondelta) + viewFocus[0],
-                        (motionVector[1]*motiondelta) + viewFocus[1],
-                        (motionVector[2]*motiondelta) + viewFocus[2]);
+  this->recordFrameDue = this->recordBuffer >= 0;
+  return 1.0 / this->RecordFrameRate;
+}
 
-  camera->SetPosition((motionVector[0]*motiondelta) + viewPoint[0],
-                      (motionVector[1]*motiondelta) + viewPoint[1],
-                      (motionVector[2]*motiondelta) + viewPoint[2]);
+// Description:
+// Read the finished frame back into the buffer and queue it for writing.
+// EndEvent comes after Frame() has swapped the buffers, and the front
+// buffer is not reliable to read (parts covered by other windows are
+// undefined). So while a frame is due the swap is held back at
+// StartEvent; the frame is then still in the back buffer at EndEvent,
+// where it is read before this swaps the buffers itself. The read is
+// synchronous: the render thread waits for the GPU to finish the frame
+// and for the pixels to arrive before it can swap and go on with the
+// next frame.
+void vtkInteractorStyleGame::DeferSwap(vtkRenderWindow *window)
+{
+  if (this->recorder == NULL || !this->recordFrameDue || this->recordBuffer < 0 || !window->GetSwapBuffers())
+    return;
+  window->SetSwapBuffers(0);
+  this->recordSwapDeferred = true;
+}
 
-  if (rwi->GetLightFollowCamera())
+void vtkInteractorStyleGame::CaptureFrame(vtkRenderWindow *window)
+{
+  if (this->recorder != NULL && this->recordFrameDue && this->recordBuffer >= 0)
     {
-    this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+    int *size = window->GetSize();
+    unsigned char *pixels = this->recorder->Buffer(this->recordBuffer, size[0], size[1]);
+    window->GetPixelData(0, 0, size[0] - 1, size[1] - 1, !window->GetDoubleBuffer(), pixels);
+    this->recorder->Submit(this->recordBuffer);
+    this->recordBuffer = -1;
+    this->recordFrameDue = false;
     }
 
-  if (this->AutoAdjustCameraClippingRange)
+  if (this->recordSwapDeferred)
     {
-    this->CurrentRenderer->ResetCameraClippingRange();
+    window->SetSwapBuffers(1);
+    window->Frame();
+    this->recordSwapDeferred = false;
     }
 }
 
 //----------------------------------------------------------------------------
-// Discription:
-// Called every timestep from ontimer to move the camera in the direction of projection based on the mouse, keyboard and gamepad movement.
-void vtkInteractorStyleGame::MoveToFocalPoint(double dt)
+std::future<bool> vtkInteractorStyleGame::PostCameraCommand(int type, double value, vtkIdType *ticket)
 {
-  if (this->CurrentRenderer == NULL)
-    {
-    return;
-    }
-
-  vtkRenderWindowInteractor *rwi = this->Interactor;
-
-  double viewFocus[3], viewPoint[3], viewUp[3];
-  double dirOfProjection[3];
-  double motiondelta = 0;
-
-  // Calculate the focal depth since we'll be using it a lot
-
-  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+  std::shared_ptr<std::promise<bool> > done = std::make_shared<std::promise<bool> >();
+  std::future<bool> result = done->get_future();
+  uint64_t id = this->cameraCommands->Push(type, value, done);
+  if (id == 0)
+    done->set_value(false);
+  if (ticket != NULL)
+    *ticket = (vtkIdType)id;
+  return result;
+}
 
-  double speed = keyboardSpeed.y +gamepadSpeed.y;
-  speed = speed > this->maxSpeed ? this->maxSpeed : speed < -this->maxSpeed ? -this->maxSpeed : speed;
+vtkIdType vtkInteractorStyleGame::PostGoToBookmark(int bookmark)
+{
+  return (vtkIdType)this->cameraCommands->Push(CAMERA_GO_TO_BOOKMARK, bookmark, NULL);
+}
 
-  motiondelta = dt*speed;
-  // XXX always seems to be 0, 0, -1
-  camera->GetDirectionOfProjection(dirOfProjection);
-  camera->GetFocalPoint(viewFocus);
-  camera->GetPosition(viewPoint);
-  camera->GetViewUp(viewUp);
+vtkIdType vtkInteractorStyleGame::PostSetSpeed(double speed)
+{
+  return (vtkIdType)this->cameraCommands->Push(CAMERA_SET_SPEED, speed, NULL);
+}
 
-    //printf("viewpoint = %f, %f, %f\n", viewPoint[0], viewPoint[1], viewPoint[2]);
-    //printf("viewfocus = %f, %f, %f\n", viewFocus[0], viewFocus[1], viewFocus[2]);
-    //printf("dirOfProjection = %f, %f, %f\n", dirOfProjection[0], dirOfProjection[1], dirOfProjection[2]);
+vtkIdType vtkInteractorStyleGame::PostTurntable(double speed)
+{
+  return (vtkIdType)this->cameraCommands->Push(CAMERA_TURNTABLE, speed, NULL);
+}
 
-  camera->SetFocalPoint((dirOfProjection[0]*motiondelta) + viewFocus[0],
-                        (dirOfProjection[1]*motiondelta) + viewFocus[1],
-                        (dirOfProjection[2]*motiondelta) + viewFocus[2]);
+vtkIdType vtkInteractorStyleGame::PostSetViewAngle(double angle)
+{
+  return (vtkIdType)this->cameraCommands->Push(CAMERA_SET_VIEW_ANGLE, angle, NULL);
+}
 
-  camera->SetPosition((dirOfProjection[0]*motiondelta) + viewPoint[0],
-                      (dirOfProjection[1]*motiondelta) + viewPoint[1],
-                      (dirOfProjection[2]*motiondelta) + viewPoint[2]);
+// Only takes the commands posted before the tick started, producers that
+// keep posting can not stall the tick
+void vtkInteractorStyleGame::ApplyCameraCommands()
+{
+  camera_command command;
+  uint64_t last = this->cameraCommands->GetLastTicket();
+  while (this->cameraCommands->Pop(&command, last))
+    {
+    if (command.type == CAMERA_GO_TO_BOOKMARK)
+      {
+      if (this->ApplyCameraCommand(command))
+        {
+        this->UpdateFlightCommands(false);
+        this->flightCommands.push_back(command);
+        }
+      else
+        this->FinishCameraCommand(command, false);
+      }
+    else
+      this->FinishCameraCommand(command, this->ApplyCameraCommand(command));
+    }
+}
 
-  if (rwi->GetLightFollowCamera())
+//----------------------------------------------------------------------------
+// Description:
+// Same limits and change bits as the corresponding keys and buttons
+bool vtkInteractorStyleGame::ApplyCameraCommand(const camera_command &command)
+{
+  switch (command.type)
     {
-    this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+    case CAMERA_GO_TO_BOOKMARK:
+      {
+      double destination[3], viewDir[3];
+      if (!this->GetBookmark((int)command.value, destination, viewDir))
+        return false;
+      this->StartFlight((int)command.value);
+      return true;
+      }
+
+    case CAMERA_SET_SPEED:
+      this->navigation.maxSpeed = std::min(std::max(command.value, 0.0), 200.0);
+      this->pendingChanges |= SpeedChanged;
+      return true;
+
+    case CAMERA_TURNTABLE:
+      if (command.value != 0 && this->modelProp3D == NULL)
+        return false;
+      if (this->navigation.turntableMode != (command.value != 0))
+        this->pendingChanges |= ModeChanged;
+      this->navigation.turntableMode = command.value != 0;
+      this->modelRotateSpeed = command.value;
+      return true;
+
+    case CAMERA_SET_VIEW_ANGLE:
+      if (this->CurrentRenderer == NULL || command.value <= 0 || command.value >= 180)
+        return false;
+      this->CurrentRenderer->GetActiveCamera()->SetViewAngle(command.value);
+      this->pendingChanges |= ViewAngleChanged;
+      return true;
     }
+  return false;
+}
 
-  if (this->AutoAdjustCameraClippingRange)
+// A bookmark command is done once the flight to its target ended, it
+// failed if the flight was stopped or another target took over
+void vtkInteractorStyleGame::UpdateFlightCommands(bool arrived)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < this->flightCommands.size(); i++)
     {
-    this->CurrentRenderer->ResetCameraClippingRange();
+    const camera_command &command = this->flightCommands[i];
+    bool current = this->navigation.flyto == (int)command.value;
+    if (this->navigation.flying && current && !arrived)
+      this->flightCommands[kept++] = command;
+    else
+      this->FinishCameraCommand(command, arrived && current);
     }
+  this->flightCommands.resize(kept);
 }
 
-//----------------------------------------------------------------------------
-void vtkInteractorStyleGame::PrintSelf(ostream& os, vtkIndent indent)
+void vtkInteractorStyleGame::FinishCameraCommand(const camera_command &command, bool result)
 {
-  this->Superclass::PrintSelf(os,indent);
-  os << indent << "MaxSpeed: " << this->maxSpeed << "\n";
+  if (command.done)
+    command.done->set_value(result);
+  double data[2] = { (double)command.ticket, result ? 1.0 : 0.0 };
+  this->InvokeEvent(CameraCommandEvent, data);
 }
 
-//----------------------------------------------------------------------------
-void vtkInteractorStyleGame::Rotate(double dt)
+// Fail the commands that will not be applied: flights still under way
+// and everything queued. Without notify only the futures are resolved,
+// for the destructor, where observers must not be called any more.
+void vtkInteractorStyleGame::DropCameraCommands(bool notify)
 {
-  if (this->CurrentRenderer == NULL)
+  std::vector<camera_command> dropped;
+  dropped.swap(this->flightCommands);
+  camera_command command;
+  uint64_t last = this->cameraCommands->GetLastTicket();
+  while (this->cameraCommands->Pop(&command, last))
+    dropped.push_back(command);
+
+  for (size_t i = 0; i < dropped.size(); i++)
     {
-    return;
+    if (notify)
+      this->FinishCameraCommand(dropped[i], false);
+    else if (dropped[i].done)
+      dropped[i].done->set_value(false);
     }
+}
 
-  vtkRenderWindowInteractor *rwi = this->Interactor;
+int vtkInteractorStyleGame::AddPrefetchBrick(const char *path, double bounds[6], vtkIdType offset, vtkIdType size)
+{
+  if (this->prefetcher == NULL || path == NULL || offset < 0 || size <= 0)
+    return -1;
+  return this->prefetcher->AddBrick(path, bounds, offset, size);
+}
 
-  int dx = 100*dt;
+int vtkInteractorStyleGame::AccessPrefetchBrick(int id)
+{
+  if (this->prefetcher == NULL)
+    return 0;
+  uint64_t size;
+  bool hit = false;
+  this->prefetcher->Access(id, &size, &hit);
+  return hit;
+}
 
-  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
-  camera->Azimuth(dx);
-  camera->OrthogonalizeViewUp();
+void vtkInteractorStyleGame::GetPrefetchStatistics(double stats[7])
+{
+  prefetch_stats s = this->prefetcher != NULL ? this->prefetcher->GetStats() : prefetch_stats();
+  stats[0] = s.hits;
+  stats[1] = s.misses;
+  stats[2] = s.prefetched;
+  stats[3] = s.evicted;
+  stats[4] = s.wasted;
+  stats[5] = s.residentBytes/(1024.0*1024.0);
+  stats[6] = s.pending;
+}
 
-  if (this->AutoAdjustCameraClippingRange)
+//----------------------------------------------------------------------------
+// Description:
+// Attach the render observers to window, detaching them from the window
+// they were attached to before. NULL only detaches.
+void vtkInteractorStyleGame::WatchRenderWindow(vtkRenderWindow *window)
+{
+  if (window == this->abortWindow)
+    return;
+
+  if (this->abortWindow != NULL)
     {
-    this->CurrentRenderer->ResetCameraClippingRange();
+    this->abortWindow->RemoveObserver(this->renderCallback);
+    this->abortWindow->UnRegister(this);
     }
 
-  if (rwi->GetLightFollowCamera())
+  this->abortWindow = window;
+  this->frameAbort.Reset();
+
+  if (window != NULL)
     {
-    this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+    window->Register(this);
+    window->AddObserver(vtkCommand::StartEvent, this->renderCallback);
+    window->AddObserver(vtkCommand::AbortCheckEvent, this->renderCallback);
+    window->AddObserver(vtkCommand::EndEvent, this->renderCallback);
     }
 }
 
-void vtkInteractorStyleGame::Up(double dt)
+//----------------------------------------------------------------------------
+// Description:
+// Move the culler to renderer, NULL takes it out. It goes first in the
+// renderer's list, so the default frustum coverage culler only sees the
+// props it left. Its grid is rebuilt for the new renderer's props.
+void vtkInteractorStyleGame::CullRenderer(vtkRenderer *renderer)
 {
-  if (this->CurrentRenderer == NULL)
-    {
+  if (renderer == this->cullRenderer)
     return;
+
+  if (this->cullRenderer != NULL)
+    {
+    this->cullRenderer->RemoveCuller(this->culler);
+    this->cullRenderer->UnRegister(this);
     }
 
-  vtkRenderWindowInteractor *rwi = this->Interactor;
+  this->cullRenderer = renderer;
+  if (renderer == NULL)
+    return;
 
-  vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
+  if (this->culler == NULL)
+    this->culler = vtkLooseGridCuller::New();
+  this->culler->Reset();
+  renderer->Register(this);
+
+  std::vector<vtkSmartPointer<vtkCuller> > others;
+  vtkCullerCollection *cullers = renderer->GetCullers();
+  vtkCollectionSimpleIterator it;
+  cullers->InitTraversal(it);
+  while (vtkCuller *other = cullers->GetNextCuller(it))
+    others.push_back(other);
+  cullers->RemoveAllItems();
+  renderer->AddCuller(this->culler);
+  for (size_t i = 0; i < others.size(); i++)
+    renderer->AddCuller(others[i]);
+}
 
-  double viewFocus[3], viewPoint[3];
+//----------------------------------------------------------------------------
+bool vtkInteractorStyleGame::InputChangedSinceRenderStart()
+{
+  PointerCapture *capture = this->pointerCapture;
+  if (capture != NULL && capture->InputPending())
+    return true;
 
-  double speed = gamepaddt.y;
-  speed = speed > this->maxSpeed ? this->maxSpeed : speed < -this->maxSpeed ? -this->maxSpeed : speed;
+  if (!this->gamepad->IsActive())
+    return false;
 
-  double dy = speed*dt;
+  this->gamepad->copyGamepadState(&this->renderCheckState);
+  return FrameAbort::GamepadChanged(this->renderStartState, this->renderCheckState, this->AbortInputThreshold);
+}
 
-  camera->GetFocalPoint(viewFocus);
-  camera->GetPosition(viewPoint);
+//----------------------------------------------------------------------------
+// Description:
+// StartEvent, AbortCheckEvent and EndEvent of the render window, the
+// abort decisions are frameAbort's. The gamepad is read through copies,
+// its reader thread may change the state meanwhile. Frames are not
+// aborted while recording.
+void vtkInteractorStyleGame::RenderCallback(vtkObject *caller, unsigned long eid, void *clientdata, void *)
+{
+  vtkInteractorStyleGame *self = static_cast<vtkInteractorStyleGame*>(clientdata);
+  vtkRenderWindow *window = static_cast<vtkRenderWindow*>(caller);
 
-  camera->SetFocalPoint(viewFocus[0], viewFocus[1] + dy, viewFocus[2]);
-  camera->SetPosition(viewPoint[0], viewPoint[1] + dy, viewPoint[2]);
+  if (eid == vtkCommand::StartEvent)
+    {
+    self->frameAbort.Start();
+    if (self->gamepad->IsActive())
+      self->gamepad->copyGamepadState(&self->renderStartState);
+    self->DeferSwap(window);
+    return;
+    }
 
-  if (rwi->GetLightFollowCamera())
+  if (eid == vtkCommand::EndEvent)
     {
-    this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+    if (self->cameraFollower != NULL && self->followerFramePending && !self->frameAbort.Aborted())
+      {
+      self->cameraFollower->SendReady();
+      self->followerFramePending = false;
+      }
+    self->CaptureFrame(window);
+    return;
     }
 
-  if (this->AutoAdjustCameraClippingRange)
+  // Followers render what the leader sends, local input does not matter
+  if (self->recorder != NULL || self->cameraFollower != NULL || !self->InterruptibleRendering)
+    return;
+
+  if (!self->frameAbort.MayAbort(self->MaxAbortedFrames))
+    return;
+
+  if (window->GetEventPending() || self->InputChangedSinceRenderStart())
     {
-    this->CurrentRenderer->ResetCameraClippingRange();
+    window->SetAbortRender(1);
+    self->frameAbort.Abort();
     }
 }
 
-void vtkInteractorStyleGame::Fly(double dt)
+//----------------------------------------------------------------------------
+void vtkInteractorStyleGame::PrintSelf(ostream& os, vtkIndent indent)
 {
-  vtkRenderWindowInteractor *rwi = this->Interactor;
-  double dest[3];
-  double viewdir[3];
-  switch(this->flyto){
-    case 1:
-      dest[0] = 0;
-      dest[1] = 0;
-      dest[2] = 0;
-      viewdir[0] = 1;
-      viewdir[1] = 0;
-      viewdir[2] = 0;
-      this->FlyTo(dt, dest, viewdir);
-    break;
-    case 2:
-      dest[0] = 0;
-      dest[1] = 1;
-      dest[2] = 0;
-      viewdir[0] = 0;
-      viewdir[1] = -1;
-      viewdir[2] = 0;
-      this->FlyTo(dt, dest, viewdir);
-    break;
-    case 3:
-      dest[0] = 0;
-      dest[1] = 0;
-      dest[2] = 1;
-      viewdir[0] = 0;
-      viewdir[1] = 0;
-      viewdir[2] = -1;
-      this->FlyTo(dt, dest, viewdir);
-    break;
-    case 4:
-      dest[0] = 1;
-      dest[1] = 0;
-      dest[2] = 0;
-      viewdir[0] = -1;
-      viewdir[1] = 0;
-      viewdir[2] = 0;
-      this->FlyTo(dt, dest, viewdir);
-    break;
-    default:;
-  }
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "MaxSpeed: " << this->navigation.maxSpeed << "\n";
+  os << indent << "GamepadDeadzone: " << this->GamepadDeadzone << "\n";
+  os << indent << "GamepadResponseExponent: " << this->GamepadResponseExponent << "\n";
+  os << indent << "GamepadThreadPriority: " << this->GamepadThreadPriority << "\n";
+  os << indent << "GamepadThreadNice: " << this->GamepadThreadNice << "\n";
+  os << indent << "GamepadThreadCPUs: " << this->GamepadThreadCPUs << "\n";
+  os << indent << "GamepadThreadMemoryLock: " << this->GamepadThreadMemoryLock << "\n";
+  os << indent << "InterruptibleRendering: " << this->InterruptibleRendering << "\n";
+  os << indent << "AbortInputThreshold: " << this->AbortInputThreshold << "\n";
+  os << indent << "MaxAbortedFrames: " << this->MaxAbortedFrames << "\n";
+  os << indent << "PrefetchHorizon: " << this->PrefetchHorizon << "\n";
+  os << indent << "PrefetchDistance: " << this->PrefetchDistance << "\n";
+  os << indent << "RecordFilePattern: " << (this->RecordFilePattern ? this->RecordFilePattern : "(none)") << "\n";
+  os << indent << "RecordFrameRate: " << this->RecordFrameRate << "\n";
+  os << indent << "RecordDropFrames: " << this->RecordDropFrames << "\n";
+  os << indent << "CoalesceInteractionEvents: " << this->CoalesceInteractionEvents << "\n";
+  os << indent << "Collision: " << this->Collision << "\n";
+  os << indent << "CollisionRadius: " << this->CollisionRadius << "\n";
+  os << indent << "AutoSpeed: " << this->AutoSpeed << "\n";
+  os << indent << "AutoSpeedDistance: " << this->AutoSpeedDistance << "\n";
+  os << indent << "AutoSpeedRange: " << this->AutoSpeedRange[0] << ", " << this->AutoSpeedRange[1] << "\n";
+  os << indent << "Picking: " << this->Picking << "\n";
+  os << indent << "Culling: " << this->Culling << "\n";
 }
 
-void vtkInteractorStyleGame::FlyTo(double dt, double* destination, double* viewDir)
+//----------------------------------------------------------------------------
+void vtkInteractorStyleGame::Rotate(double dt)
 {
   if (this->CurrentRenderer == NULL)
     {
@@ -654,76 +1564,58 @@ void vtkInteractorStyleGame::FlyTo(double dt, double* destination, double* viewD
 
   vtkRenderWindowInteractor *rwi = this->Interactor;
 
-  double focalPoint[3], camposition[3], viewUp[3];
-  double dirOfProjection[3];
-  double motionvector[3];
-  double motiondelta = dt;
-  bool transdone = false;
-  bool rotdone = false;
+  int dx = 100*dt;
 
   vtkCamera *camera = this->CurrentRenderer->GetActiveCamera();
-  camera->GetDirectionOfProjection(dirOfProjection);
-  camera->GetFocalPoint(focalPoint);
-  camera->GetPosition(camposition);
-  camera->GetViewUp(viewUp);
-
-  motionvector[0] = destination[0] -  camposition[0];
-  motionvector[1] = destination[1] -  camposition[1];
-  motionvector[2] = destination[2] -  camposition[2];
-
-  if(vtkMath::Norm(motionvector) > 0.1)
-  {
-    vtkMath::Normalize(motionvector);
-
-    camera->SetFocalPoint((motionvector[0]*motiondelta/2) + focalPoint[0],
-                          (motionvector[1]*motiondelta/2) + focalPoint[1],
-                          (motionvector[2]*motiondelta/2) + focalPoint[2]);
-
-    camera->SetPosition((motionvector[0]*motiondelta/2) + camposition[0],
-                        (motionvector[1]*motiondelta/2) + camposition[1],
-                        (motionvector[2]*motiondelta/2) + camposition[2]);
-
-    camera->OrthogonalizeViewUp();
-  } else {
-    transdone = true;
-  }
+  camera->Azimuth(dx);
+  camera->OrthogonalizeViewUp();
 
-  camera->GetDirectionOfProjection(dirOfProjection);
-  camera->GetFocalPoint(focalPoint);
-  camera->GetPosition(camposition);
-  camera->GetViewUp(viewUp);
+  if (this->AutoAdjustCameraClippingRange)
+    {
+    this->CurrentRenderer->ResetCameraClippingRange();
+    }
 
-  double axis[3];
-  vtkMath::Cross(dirOfProjection, viewDir, axis);
+  if (rwi->GetLightFollowCamera())
+    {
+    this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+    }
+}
 
-  if(vtkMath::Norm(axis) > 0.1)
-  {
-    vtkMath::Normalize(axis);
-    vtkSmartPointer<vtkTransform> trans = vtkSmartPointer<vtkTransform>::New();
-    // translate the camera to the origin,
-    // rotate about axis,
-    // translate back again
-    trans->Translate(+camposition[0],+camposition[1],+camposition[2]);
-    trans->RotateWXYZ(motiondelta*50,axis);
-    trans->Translate(-camposition[0],-camposition[1],-camposition[2]);
-
-    trans->TransformPoint(focalPoint,focalPoint);
-    camera->SetFocalPoint(focalPoint);
-    camera->OrthogonalizeViewUp();
-  }
-  else{
-    rotdone = true;
-  }
+//----------------------------------------------------------------------------
+// Description:
+// Destination and view direction of the fixed fly targets 1 to 4
+bool vtkInteractorStyleGame::GetBookmark(int target, double* destination, double* viewDir)
+{
+  return NavigationIntegrator::GetBookmark(target, destination, viewDir);
+}
 
-  this->flying = !(transdone & rotdone);
+//----------------------------------------------------------------------------
+// Description:
+// Only the ray is computed here, from the current camera; the BVH
+// traversal runs on the picker's worker thread.
+void vtkInteractorStyleGame::FlyToPick(int x, int y)
+{
+  if (!this->Picking || this->CurrentRenderer == NULL)
+    {
+    return;
+    }
 
-  if (rwi->GetLightFollowCamera())
+  double ends[2][4];
+  for (int i = 0; i < 2; i++)
     {
-    this->CurrentRenderer->UpdateLightsGeometryToFollowCamera();
+    this->CurrentRenderer->SetDisplayPoint(x, y, i);
+    this->CurrentRenderer->DisplayToWorld();
+    this->CurrentRenderer->GetWorldPoint(ends[i]);
+    if (ends[i][3] != 0.0)
+      for (int k = 0; k < 3; k++)
+        ends[i][k] /= ends[i][3];
     }
-  if (this->AutoAdjustCameraClippingRange)
-  {
-    this->CurrentRenderer->ResetCameraClippingRange();
-  }
+
+  double direction[3];
+  vtkMath::Subtract(ends[1], ends[0], direction);
+
+  if (this->scenePicker == NULL)
+    this->scenePicker = new ScenePicker();
+  this->scenePicker->Request(ends[0], direction);
 }
 
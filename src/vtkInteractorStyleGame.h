@@ -20,8 +20,29 @@
 #define vtkInteractorStyleGame_h
 
 #include "vtkInteractorStyle.h"
+#include "vtkCommand.h"
 #include <time.h>
 #include "GamepadHandler.h"
+#include "AxisIntegrator.h"
+#include "PointerCapture.h"
+#include "NavigationIntegrator.h"
+#include "CameraSync.h"
+#include "GamepadStream.h"
+#include "SharedState.h"
+#include "SceneBVH.h"
+#include "ClearanceField.h"
+#include "ScenePicker.h"
+#include "BrickPrefetcher.h"
+#include "FrameRecorder.h"
+#include "FrameAbort.h"
+#include "CameraCommandQueue.h"
+#include <vector>
+
+class vtkCallbackCommand;
+class vtkCamera;
+class vtkDoubleArray;
+class vtkLooseGridCuller;
+class vtkRenderWindow;
 
 class VTK_EXPORT vtkInteractorStyleGame : public vtkInteractorStyle
 {
@@ -30,14 +51,293 @@ public:
 
   static vtkInteractorStyleGame *New();  
   void PrintSelf(ostream& os, vtkIndent indent);
-  clock_t t;
+  // Description:
+  // Time of the previous tick, in CLOCK_MONOTONIC seconds. All speeds
+  // (maxSpeed, look speeds, flights) are per second of wall time.
+  // Earlier versions measured ticks in CPU time of the viewer process
+  // (clock()), which stands still while it waits for vsync or events, so
+  // the same settings now move the camera faster: by the ratio of wall
+  // time to CPU time, typically several times.
+  double t;
   enum direction_t{ MOVE_RIGHT, MOVE_LEFT , MOVE_FORWARD, MOVE_BACKWARD};
   struct movement_t{ bool forward; bool backward; bool left; bool right;} movement;
-  struct deltaMovement_t{ double x; double y;} mousedt, gamepaddt;
-  struct motionfactor_t{double x; double y;} gamepadSpeed, keyboardSpeed;
+  struct deltaMovement_t{ double x; double y;} mousedt;
 
   virtual void SetModelProp3D(vtkProp3D *prop);
 
+  // Description:
+  // Backend used to grab the pointer for mouse-look. By default one is
+  // picked to match the render window; setting one transfers ownership.
+  void SetPointerCapture(PointerCapture *capture);
+  PointerCapture* GetPointerCapture();
+
+  // Description:
+  // Take gamepad input from a gamepadforward daemon sending to the given
+  // UDP port instead of the local device.
+  bool StartRemoteGamepad(int port);
+
+  // Description:
+  // Replace the gamepad input, the style takes ownership of the source
+  void SetGamepadSource(GamepadSource *source);
+
+  // Description:
+  // Filters for the analog sticks, applied to every axis sample before
+  // the samples of a tick are integrated. GamepadDeadzone is a fraction
+  // of the axis range (default 0); GamepadResponseExponent shapes the
+  // rest of the range, 1 (the default) is linear and larger values give
+  // finer control near the center.
+  vtkSetClampMacro(GamepadDeadzone, double, 0.0, 0.99);
+  vtkGetMacro(GamepadDeadzone, double);
+  vtkSetClampMacro(GamepadResponseExponent, double, 0.1, 10.0);
+  vtkGetMacro(GamepadResponseExponent, double);
+
+  // Description:
+  // Scheduling of the local gamepad's reader thread, for steady input
+  // latency while the CPUs are loaded (see gp_thread_options).
+  // GamepadThreadPriority > 0 asks for SCHED_FIFO at that priority, 0
+  // keeps the normal policy with GamepadThreadNice. GamepadThreadCPUs is
+  // a comma separated list of CPUs the thread may run on ("2,3"), empty
+  // for any. GamepadThreadMemoryLock keeps its memory resident. Every
+  // setter applies the options to the current gamepad, a new local
+  // gamepad gets them too; settings the system refuses are reported and
+  // skipped.
+  void SetGamepadThreadPriority(int priority);
+  vtkGetMacro(GamepadThreadPriority, int);
+  void SetGamepadThreadNice(int nice);
+  vtkGetMacro(GamepadThreadNice, int);
+  void SetGamepadThreadCPUs(const char *cpus);
+  const char *GetGamepadThreadCPUs() { return this->GamepadThreadCPUs.c_str(); }
+  void SetGamepadThreadMemoryLock(int lock);
+  vtkGetMacro(GamepadThreadMemoryLock, int);
+  vtkBooleanMacro(GamepadThreadMemoryLock, int);
+
+  // Description:
+  // Publish camera pose, speeds, mode flags, the gamepad state and frame
+  // timing every tick to the POSIX shared memory segment name (e.g.
+  // "/vtkgame"), for other processes to read with SharedStateReader.
+  bool StartSharedStateExport(const char *name);
+  void StopSharedStateExport();
+
+  // Description:
+  // Collision mode: camera translation is swept against a BVH over the
+  // visible actors' polydata (built in the background) and slides along
+  // surfaces instead of passing through them. CollisionRadius is the
+  // closest the camera gets to a surface, in world units. Flights stop
+  // when they run into a surface.
+  vtkSetMacro(Collision, int);
+  vtkGetMacro(Collision, int);
+  vtkBooleanMacro(Collision, int);
+  vtkSetMacro(CollisionRadius, double);
+  vtkGetMacro(CollisionRadius, double);
+
+  // Description:
+  // Automatic speed: translation speed is scaled by the clearance to the
+  // nearest surface, taken from a distance grid computed in the
+  // background. At AutoSpeedDistance from a surface the scale is 1, the
+  // scale is clamped to AutoSpeedRange.
+  vtkSetMacro(AutoSpeed, int);
+  vtkGetMacro(AutoSpeed, int);
+  vtkBooleanMacro(AutoSpeed, int);
+  vtkSetMacro(AutoSpeedDistance, double);
+  vtkGetMacro(AutoSpeedDistance, double);
+  vtkSetVector2Macro(AutoSpeedRange, double);
+  vtkGetVector2Macro(AutoSpeedRange, double);
+
+  // Description:
+  // Fly towards the surface point under display position x, y. The pick
+  // runs on a worker thread against the scene BVH with the camera as it
+  // is now, navigation continues meanwhile and the flight starts when the
+  // result comes in (fly target 5). Bound to the f key (pointer position)
+  // and gamepad button 11 (window center).
+  void FlyToPick(int x, int y);
+
+  // Description:
+  // With Picking on (the default) the first FlyToPick builds the scene
+  // BVH, unless Collision or AutoSpeed already did, and waits for the
+  // build; from then on the BVH is kept up to date every tick. A viewer
+  // that never picks pays nothing. With Picking off FlyToPick does
+  // nothing and the BVH is no longer updated for picks.
+  vtkSetMacro(Picking, int);
+  vtkGetMacro(Picking, int);
+  vtkBooleanMacro(Picking, int);
+
+  // Description:
+  // Culling puts a vtkLooseGridCuller in front of the current renderer's
+  // cullers, so a frame only tests the parts of the scene the camera
+  // motion can have brought into or out of view. Pays off for scenes of
+  // many props. Off by default.
+  vtkSetMacro(Culling, int);
+  vtkGetMacro(Culling, int);
+  vtkBooleanMacro(Culling, int);
+
+  // Description:
+  // Interruptible rendering: during a render the window's abort checks
+  // look for new input (queued keyboard or pointer events, a stick moved
+  // more than AbortInputThreshold of its range or a gamepad button
+  // changed since the frame started) and abort the frame, so the next
+  // tick renders with the updated camera instead. Only renders that check
+  // for aborts can be cut short: multi-pass (anti-aliasing, focal depth,
+  // subframes) and progressive volume rendering. After MaxAbortedFrames
+  // aborted frames in a row a frame is always completed, so continuous
+  // input cannot keep the display from updating.
+  vtkSetMacro(InterruptibleRendering, int);
+  vtkGetMacro(InterruptibleRendering, int);
+  vtkBooleanMacro(InterruptibleRendering, int);
+  vtkSetClampMacro(AbortInputThreshold, double, 0.0, 1.0);
+  vtkGetMacro(AbortInputThreshold, double);
+  vtkSetClampMacro(MaxAbortedFrames, int, 0, VTK_INT_MAX);
+  vtkGetMacro(MaxAbortedFrames, int);
+
+  // Description:
+  // Where the camera is heading: translation velocity in world units per
+  // second and yaw rate in degrees per second around the view up, from
+  // the current stick, key and fly-to state.
+  void GetCameraVelocity(double velocity[3]);
+  double GetCameraYawRate();
+
+  // Description:
+  // Out-of-core prefetching: bricks of data files (a byte range plus
+  // world bounds each, added with AddPrefetchBrick) that the camera is
+  // predicted to see within PrefetchHorizon seconds are read into memory
+  // ahead of time, within a budget of memoryMB. Readers report their use
+  // of a brick with AccessPrefetchBrick(), which returns 1 when it was
+  // already resident. PrefetchDistance limits how far ahead of the
+  // camera bricks are wanted, 0 uses the far clipping plane.
+  bool StartPrefetch(double memoryMB);
+  void StopPrefetch();
+  int AddPrefetchBrick(const char *path, double bounds[6], vtkIdType offset, vtkIdType size);
+  int AccessPrefetchBrick(int id);
+  vtkSetMacro(PrefetchHorizon, double);
+  vtkGetMacro(PrefetchHorizon, double);
+  vtkSetMacro(PrefetchDistance, double);
+  vtkGetMacro(PrefetchDistance, double);
+
+  // Description:
+  // Prefetch statistics: hits, misses, bricks prefetched, evicted, evicted
+  // without use, resident megabytes and bricks still to be loaded.
+  void GetPrefetchStatistics(double stats[7]);
+
+  // Description:
+  // Recording: while on, every rendered frame is read back from the back
+  // buffer into one of a few reusable buffers and written as a numbered
+  // PNG file by worker threads. The read back is synchronous: the swap
+  // and the next frame wait until the GPU has finished the frame and the
+  // pixels have arrived, only compressing and writing overlap rendering.
+  // RecordFilePattern is a printf format with exactly one integer
+  // conversion for the frame number (default "frame%05d.png"), otherwise
+  // StartRecording() fails. The camera advances by a fixed
+  // 1/RecordFrameRate seconds per frame, so the recording plays back
+  // smoothly at that rate however long rendering and writing took. When
+  // the writers fall behind the camera waits for them, or with
+  // RecordDropFrames on, frames are left out of the recording instead.
+  // The r key toggles recording; progress is in GetRecordStatistics(),
+  // start and end are reported with Debug on.
+  bool StartRecording();
+  void StopRecording();
+  int GetRecording() { return this->recorder != NULL; }
+  vtkSetStringMacro(RecordFilePattern);
+  vtkGetStringMacro(RecordFilePattern);
+  vtkSetClampMacro(RecordFrameRate, double, 1.0, 1000.0);
+  vtkGetMacro(RecordFrameRate, double);
+  vtkSetMacro(RecordDropFrames, int);
+  vtkGetMacro(RecordDropFrames, int);
+  vtkBooleanMacro(RecordDropFrames, int);
+
+  // Description:
+  // Recording statistics: frames captured, written, failed to write,
+  // ticks without a free buffer and frames waiting to be written.
+  void GetRecordStatistics(double stats[5]);
+
+  // Description:
+  // Camera commands that may be posted from any thread (loaders, Python
+  // threads, remote control). Posting never blocks: the commands go into
+  // a lock-free queue that OnTimer() applies at the start of the next
+  // tick, in the order they were posted. Each call returns a ticket > 0,
+  // or 0 when the queue is full. When a command is done CameraCommandEvent
+  // is fired on the interactor thread with the ticket and the result (1
+  // or 0) as a double[2] call data. Going to a bookmark is done when the
+  // flight ends, with result 0 if another flight replaced it. A turntable
+  // speed of 0 stops the turntable; it needs a model prop. A camera sync
+  // follower fails every command, and so does deleting the style (which
+  // only resolves the futures, without events).
+  enum { CameraCommandEvent = vtkCommand::UserEvent + 1 };
+  vtkIdType PostGoToBookmark(int bookmark);
+  vtkIdType PostSetSpeed(double speed);
+  vtkIdType PostTurntable(double speed);
+  vtkIdType PostSetViewAngle(double angle);
+
+  // Description:
+  // Same for C++ callers, who can wait on the returned future instead
+  // (type is a camera_command_type)
+  std::future<bool> PostCameraCommand(int type, double value, vtkIdType *ticket = NULL);
+
+  // Description:
+  // Run the navigation of OnTimer() over a batch of input samples without
+  // rendering, starting from the current camera, speeds and flight. The
+  // input has NAV_SAMPLE_SIZE components per tuple (see
+  // NavigationIntegrator.h), each sample is held until the next sample's
+  // time. For every sample the position, focal point and view up at its
+  // time are written as one 9-component tuple to output, so the first
+  // tuple is the current camera. Collision and AutoSpeed use the scene as
+  // it is now; the samples do not pick, but a pick flight under way
+  // continues. Neither the camera nor the style's state is changed.
+  // Arrays wrapping NumPy buffers (numpy_support.numpy_to_vtk with
+  // deep=0) are used in place, an output already sized to N tuples is
+  // written without reallocation.
+  void SimulateNavigation(vtkDoubleArray *input, vtkDoubleArray *output);
+
+  // Description:
+  // Bits in the first element of the interaction summary
+  enum InteractionChange
+  {
+    ModeChanged = 1,
+    SpeedChanged = 2,
+    FlyStarted = 4,
+    FlyStopped = 8,         // a flight was given up: new target or blocked
+    FlyArrived = 16,        // a flight reached its bookmark or picked point
+    KeysChanged = 32,
+    ViewAngleChanged = 64
+  };
+
+  // Description:
+  // When on (the default), state changes are collected during a tick and
+  // OnTimer() fires a single InteractionEvent for the tick if anything
+  // changed. When off, every key press and release fires its own
+  // InteractionEvent. Either way, auto-repeat of a held key only counts
+  // when it changes something, like the speed and view angle keys do.
+  vtkSetMacro(CoalesceInteractionEvents, int);
+  vtkGetMacro(CoalesceInteractionEvents, int);
+  vtkBooleanMacro(CoalesceInteractionEvents, int);
+
+  // Description:
+  // Payload of the last coalesced InteractionEvent, also passed as its
+  // call data: InteractionChange bits, turntable mode, max speed, flying,
+  // fly target and view angle.
+  vtkGetVector6Macro(InteractionSummary, double);
+
+  // Description:
+  // Leader/follower camera sync for display walls. The leader publishes
+  // its camera and model transform to a UDP multicast group every tick.
+  // A follower ignores local input and applies the received pose, with
+  // TileOffset as the camera window center of its tile.
+  bool StartCameraBroadcast(const char *group, int port);
+  bool StartCameraFollow(const char *group, int port);
+  void StopCameraSync();
+  vtkSetVector2Macro(TileOffset, double);
+  vtkGetVector2Macro(TileOffset, double);
+
+  // Description:
+  // Frame pacing: before publishing the next pose the leader waits for
+  // this many followers to report the previous one rendered, but never
+  // longer than FramePacingTimeout milliseconds. This is best-effort, not
+  // a swap lock: followers do not wait for each other before swapping, so
+  // tiles can still show different frames for a moment. 0 (the default)
+  // disables the wait.
+  vtkSetMacro(FramePacingFollowers, int);
+  vtkGetMacro(FramePacingFollowers, int);
+  vtkSetMacro(FramePacingTimeout, double);
+  vtkGetMacro(FramePacingTimeout, double);
+
   //struct flyState_t{bool flying; } flyState;
   // Description:
   // Event bindings controlling the effects of pressing mouse buttons
@@ -51,44 +351,108 @@ public:
   // These methods for the different interactions in different modes
   // are overridden in subclasses to perform the correct motion. Since
   // they are called by OnTimer, they do not have mouse coord parameters
-  // (use interactor's GetEventPosition and GetLastEventPosition)
-  virtual void CameraYaw(double dt);
+  // (use interactor's GetEventPosition and GetLastEventPosition). The
+  // camera navigation itself is done by the NavigationIntegrator.
   virtual void CameraPitch(double dt);
-  virtual void CameraRoll(double dt);
-  virtual void Pan(double dt);
-  virtual void MoveToFocalPoint(double dt);
   virtual void HandleKeys(std::string key, bool down);
   virtual void handleGamepadState(gp_state* gpst);
   virtual void Rotate(double dt);
-  virtual void Fly(double dt);
-  virtual void FlyTo(double dt, double* destination, double* viewDir);
-  virtual void Up(double dt);
+  bool GetBookmark(int target, double* destination, double* viewDir);
   virtual void ModelRotate(double dt);
 
 protected:
   vtkInteractorStyleGame();
   ~vtkInteractorStyleGame();
-  bool turntableMode;
-  bool modeButtonDown;       // Wether key used for switching mode is still pressed
+  void InvokeInteractionSummary();
+  void FlushKeyRelease();
+  void StartFlight(int target);
+  void BroadcastCamera();
+  void FollowCamera();
+  double TickTime();
+  void ExportSharedState(double dt);
+  double CollideMotion(const double *from, double *motion);
+  void WatchRenderWindow(vtkRenderWindow *window);
+  void CullRenderer(vtkRenderer *renderer);
+  bool InputChangedSinceRenderStart();
+  double RecordStep();
+  void ApplyCameraCommands();
+  bool ApplyCameraCommand(const camera_command &command);
+  void UpdateFlightCommands(bool arrived);
+  void FinishCameraCommand(const camera_command &command, bool result);
+  void DropCameraCommands(bool notify);
+  bool ApplyGamepadThreadOptions();
+  void DeferSwap(vtkRenderWindow *window);
+  void CaptureFrame(vtkRenderWindow *window);
+  double SpeedScaleAt(const double *position);
+  static void RenderCallback(vtkObject *caller, unsigned long eid, void *clientdata, void *calldata);
+  NavigationIntegrator navigation;  // speeds, mode and flight of the camera
   bool keyPressedDown;
-  double maxSpeed;
-  double gamepadLookSpeed;
   double mouseLookSpeed;
-  double gamepadRoll;
-  double keyboardRoll;
   bool advancedSettings;
   bool rotate;
-  bool flying;
-  int flyto;
   vtkProp3D* modelProp3D;
   double modelRotateSpeed;
   double *modelCenter;
   double modelRotation; // Around world Y axis
+  int CoalesceInteractionEvents;
+  int pendingChanges;        // InteractionChange bits collected this tick
+  double InteractionSummary[6];
+  CameraSyncLeader* cameraLeader;
+  CameraSyncFollower* cameraFollower;
+  double TileOffset[2];
+  int FramePacingFollowers;
+  double FramePacingTimeout;
+  bool followerFramePending;  // received pose not rendered yet
+  SharedStateWriter* sharedState;
+  uint64_t sharedStateFrame;
+  int Collision;
+  double CollisionRadius;
+  SceneBVH* sceneBVH;
+  int AutoSpeed;
+  double AutoSpeedDistance;
+  double AutoSpeedRange[2];
+  ClearanceField* clearanceField;
+  int Picking;
+  ScenePicker* scenePicker;
+  int Culling;
+  vtkLooseGridCuller* culler;
+  vtkRenderer* cullRenderer;        // renderer the culler is added to
+  double GamepadDeadzone;
+  int GamepadThreadPriority;
+  int GamepadThreadNice;
+  std::string GamepadThreadCPUs;
+  int GamepadThreadMemoryLock;
+  double GamepadResponseExponent;
+  AxisIntegrator* axisIntegrator;
+  int InterruptibleRendering;
+  double AbortInputThreshold;
+  int MaxAbortedFrames;
+  vtkRenderWindow* abortWindow;     // window the render observers are attached to
+  vtkCallbackCommand* renderCallback;
+  gp_state renderStartState;        // gamepad state when the current frame started
+  gp_state renderCheckState;        // gamepad state at the last abort check
+  FrameAbort frameAbort;
+  BrickPrefetcher* prefetcher;
+  double PrefetchHorizon;
+  double PrefetchDistance;
+  FrameRecorder* recorder;
+  char* RecordFilePattern;
+  double RecordFrameRate;
+  int RecordDropFrames;
+  int recordBuffer;          // recorder buffer for the next frame, -1 if none
+  bool recordFrameDue;       // camera advanced, frame not captured yet
+  bool recordSwapDeferred;   // buffer swap held back until the frame is read
+  CameraCommandQueue* cameraCommands;
+  std::vector<camera_command> flightCommands;  // bookmark commands still flying
+  bool pickButtonDown;
+  std::string releasedKey;   // key release held back to detect auto-repeat
 
 private:
+  friend class vtkGameNavigationScene;
   vtkInteractorStyleGame(const vtkInteractorStyleGame&);  // Not implemented.
   void operator=(const vtkInteractorStyleGame&);  // Not implemented.
-  GamepadHandler* gamepad;
+  GamepadSource* gamepad;
+  PointerCapture* pointerCapture;
 };
 
 #endif
\ No newline at end of file
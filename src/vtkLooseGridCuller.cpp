@@ -0,0 +1,189 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkLooseGridCuller.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+#include "vtkLooseGridCuller.h"
+
+#include "vtkActor.h"
+#include "vtkCamera.h"
+#include "vtkDataSet.h"
+#include "vtkMapper.h"
+#include "vtkMath.h"
+#include "vtkObjectFactory.h"
+#include "vtkProp.h"
+#include "vtkRenderer.h"
+#include "LooseGrid.h"
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+vtkStandardNewMacro(vtkLooseGridCuller);
+
+class vtkLooseGridCullerInternals
+{
+public:
+  vtkLooseGridCullerInternals() : grid(NULL) {}
+  ~vtkLooseGridCullerInternals() { delete this->grid; }
+
+  LooseGrid *grid;               // NULL until the cell size is known
+  std::vector<int> listRecords;  // grid record of each prop in the list
+};
+
+//----------------------------------------------------------------------------
+vtkLooseGridCuller::vtkLooseGridCuller()
+{
+  this->CellSize = 0.0;
+  this->CellsTested = 0;
+  this->PropsTested = 0;
+  this->PropsCulled = 0;
+  this->Internals = new vtkLooseGridCullerInternals;
+}
+
+vtkLooseGridCuller::~vtkLooseGridCuller()
+{
+  delete this->Internals;
+}
+
+void vtkLooseGridCuller::Reset()
+{
+  delete this->Internals->grid;
+  this->Internals->grid = NULL;
+}
+
+//----------------------------------------------------------------------------
+// Prop MTime does not change when the mapper's input does
+static unsigned long propTime(vtkProp *prop)
+{
+  unsigned long time = prop->GetMTime();
+  vtkActor *actor = vtkActor::SafeDownCast(prop);
+  if (actor != NULL && actor->GetMapper() != NULL)
+    {
+    time = std::max(time, (unsigned long)actor->GetMapper()->GetMTime());
+    vtkDataSet *input = actor->GetMapper()->GetInput();
+    if (input != NULL)
+      time = std::max(time, (unsigned long)input->GetMTime());
+    }
+  return time;
+}
+
+// The frustum with unit plane normals, and what tells its motion from a
+// change of its shape
+static void getView(vtkRenderer *ren, grid_view *view)
+{
+  vtkCamera *camera = ren->GetActiveCamera();
+  view->aspect = ren->GetTiledAspectRatio();
+  camera->GetFrustumPlanes(view->aspect, view->planes);
+  for (int i = 0; i < 6; i++)
+    {
+    double length = vtkMath::Norm(view->planes + 4*i);
+    for (int k = 0; k < 4; k++)
+      view->planes[4*i+k] /= length;
+    }
+  camera->GetPosition(view->position);
+  camera->GetDirectionOfProjection(view->direction);
+  camera->GetViewUp(view->viewUp);
+  vtkMath::Normalize(view->viewUp);
+  camera->GetClippingRange(view->clippingRange);
+  view->viewAngle = camera->GetViewAngle();
+  view->parallel = camera->GetParallelProjection();
+  view->parallelScale = camera->GetParallelScale();
+  double *windowCenter = camera->GetWindowCenter();
+  view->windowCenter[0] = windowCenter[0];
+  view->windowCenter[1] = windowCenter[1];
+}
+
+//----------------------------------------------------------------------------
+// Description:
+// The grid (LooseGrid) decides which cells to test; the prop list itself
+// is still walked once (see the class description).
+double vtkLooseGridCuller::Cull(vtkRenderer *ren, vtkProp **propList, int& listLength, int& initialized)
+{
+  vtkLooseGridCullerInternals *in = this->Internals;
+  this->CellsTested = 0;
+  this->PropsTested = 0;
+  this->PropsCulled = 0;
+
+  // Pick a cell size for about eight props per cell
+  double size = this->CellSize;
+  if (size <= 0 && in->grid != NULL)
+    size = in->grid->GetCellSize();
+  if (size <= 0)
+    {
+    double bounds[6] = { VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+    for (int i = 0; i < listLength; i++)
+      {
+      double *b = propList[i]->GetBounds();
+      if (b == NULL || b[0] > b[1])
+        continue;
+      for (int k = 0; k < 3; k++)
+        {
+        bounds[2*k] = std::min(bounds[2*k], b[2*k]);
+        bounds[2*k+1] = std::max(bounds[2*k+1], b[2*k+1]);
+        }
+      }
+    if (bounds[0] > bounds[1])
+      return listLength;
+    double diagonal = sqrt((bounds[1]-bounds[0])*(bounds[1]-bounds[0]) + (bounds[3]-bounds[2])*(bounds[3]-bounds[2]) +
+                           (bounds[5]-bounds[4])*(bounds[5]-bounds[4]));
+    size = std::max(diagonal / cbrt(std::max(listLength/8.0, 1.0)), 1e-6);
+    }
+  if (in->grid == NULL || size != in->grid->GetCellSize())
+    {
+    delete in->grid;
+    in->grid = new LooseGrid(size);
+    }
+  LooseGrid *grid = in->grid;
+
+  grid->BeginFrame();
+  in->listRecords.resize(listLength);
+  for (int i = 0; i < listLength; i++)
+    {
+    bool stale;
+    int id = grid->Touch(propList[i], propTime(propList[i]), &stale);
+    if (stale)
+      grid->SetBounds(id, propList[i]->GetBounds());
+    in->listRecords[i] = id;
+    }
+
+  grid_view view;
+  getView(ren, &view);
+  grid->Classify(view);
+  this->CellsTested = grid->GetCellsTested();
+  this->PropsTested = grid->GetBoxesTested();
+
+  double total = 0.0;
+  int kept = 0;
+  for (int i = 0; i < listLength; i++)
+    {
+    if (!grid->IsVisible(in->listRecords[i]))
+      continue;
+    if (!initialized)
+      propList[i]->SetRenderTimeMultiplier(1.0);
+    total += propList[i]->GetRenderTimeMultiplier();
+    propList[kept++] = propList[i];
+    }
+  this->PropsCulled = listLength - kept;
+  listLength = kept;
+  initialized = 1;
+  return total;
+}
+
+//----------------------------------------------------------------------------
+void vtkLooseGridCuller::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "CellSize: " << this->CellSize << "\n";
+  os << indent << "CellsTested: " << this->CellsTested << "\n";
+  os << indent << "PropsTested: " << this->PropsTested << "\n";
+  os << indent << "PropsCulled: " << this->PropsCulled << "\n";
+}
@@ -0,0 +1,87 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkLooseGridCuller.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkLooseGridCuller - frustum culling over a loose grid of prop bounds
+// .SECTION Description
+// Props are binned by the center of their bounds into a uniform grid,
+// each cell keeps the union of its props' bounds. Per frame only cells
+// the camera motion since their last test could have moved across a
+// frustum plane are tested again; the props of a cell are tested one by
+// one only while the cell straddles the frustum boundary. Props added,
+// moved or modified mark their cells for a new test. Cells that need a
+// test are found through lists of changed and straddling cells and heaps
+// of deadlines on the camera motion, so the frustum work per frame
+// follows the cells that can change, not the size of the scene. That
+// state lives in a LooseGrid, the culler feeds it the props and the
+// camera.
+//
+// The vtkCuller API hands the whole prop list to every Cull() and takes
+// the visible props back in it, so one pass over the list (looking up
+// each prop's record, checking its MTime, compacting the list) remains
+// per frame; that O(N) floor can not be avoided by a culler. Add it to
+// a renderer with AddCuller(), or through the Culling option of
+// vtkInteractorStyleGame; it does not compute coverage, so it can
+// replace or run before the default vtkFrustumCoverageCuller.
+
+#ifndef vtkLooseGridCuller_h
+#define vtkLooseGridCuller_h
+
+#include "vtkCuller.h"
+
+class vtkLooseGridCullerInternals;
+
+class VTK_EXPORT vtkLooseGridCuller : public vtkCuller
+{
+public:
+  static vtkLooseGridCuller *New();
+  vtkTypeMacro(vtkLooseGridCuller,vtkCuller);
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+  // Description:
+  // Edge length of the grid cells in world units. 0 (the default) picks
+  // a size from the props' bounds when the grid is first built.
+  vtkSetMacro(CellSize, double);
+  vtkGetMacro(CellSize, double);
+
+  // Description:
+  // Work done by the last Cull(): cells and props tested against the
+  // frustum, and props culled.
+  vtkGetMacro(CellsTested, int);
+  vtkGetMacro(PropsTested, int);
+  vtkGetMacro(PropsCulled, int);
+
+  // Description:
+  // Drop the grid, the next Cull() rebuilds it and tests everything
+  void Reset();
+
+  // Description:
+  // Remove the props outside the view frustum from propList
+  virtual double Cull(vtkRenderer *ren, vtkProp **propList, int& listLength, int& initialized);
+
+protected:
+  vtkLooseGridCuller();
+  ~vtkLooseGridCuller();
+
+  double CellSize;
+  int CellsTested;
+  int PropsTested;
+  int PropsCulled;
+  vtkLooseGridCullerInternals *Internals;
+
+private:
+  vtkLooseGridCuller(const vtkLooseGridCuller&);  // Not implemented.
+  void operator=(const vtkLooseGridCuller&);  // Not implemented.
+};
+
+#endif
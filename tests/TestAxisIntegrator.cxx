@@ -0,0 +1,106 @@
+// Stick integration over a tick and the mapping of the driver's event
+// times to CLOCK_MONOTONIC
+
+#include "AxisIntegrator.h"
+#include "TestCheck.h"
+
+static gp_axis_sample sample(double time, int number, signed short value)
+{
+    gp_axis_sample s;
+    s.time = s.delivered = time;
+    s.number = number;
+    s.value = value;
+    return s;
+}
+
+static void testFilter()
+{
+    CHECK_NEAR(AxisIntegrator::Filter(0.1, 0.2, 1), 0, 1e-12);
+    CHECK_NEAR(AxisIntegrator::Filter(-0.6, 0.2, 1), -0.5, 1e-12);
+    CHECK_NEAR(AxisIntegrator::Filter(0.6, 0.2, 2), 0.25, 1e-12);
+    CHECK_NEAR(AxisIntegrator::Filter(2.0, 0.2, 2), 1, 1e-12);
+}
+
+static void testIntegrate()
+{
+    AxisIntegrator integrator;
+    std::vector<gp_axis_sample> samples;
+    std::vector<signed short> current(2, 0);
+
+    // The first call has no interval, the current values are the mean
+    current[0] = 32767;
+    integrator.Integrate(samples, current, 10.0);
+    CHECK_NEAR(integrator.GetAxis(0), 1, 1e-12);
+    CHECK_NEAR(integrator.GetAxis(1), 0, 1e-12);
+    CHECK_NEAR(integrator.GetAxis(5), 0, 1e-12);
+
+    // Axis 0 let go a quarter into the tick, axis 1 flicked in between
+    samples.push_back(sample(10.025, 0, 0));
+    samples.push_back(sample(10.05, 1, -32767));
+    samples.push_back(sample(10.075, 1, 0));
+    current[0] = 0;
+    current[1] = 0;
+    integrator.Integrate(samples, current, 10.1);
+    CHECK_NEAR(integrator.GetAxis(0), 0.25, 1e-9);
+    CHECK_NEAR(integrator.GetAxis(1), -0.25, 1e-9);
+
+    // Late samples count from the start of the interval
+    samples.clear();
+    samples.push_back(sample(10.0, 0, 32767));
+    current[0] = 32767;
+    integrator.Integrate(samples, current, 10.2);
+    CHECK_NEAR(integrator.GetAxis(0), 1, 1e-9);
+
+    // Without samples the current values hold for the whole tick, not the
+    // values of the previous tick
+    samples.clear();
+    current[0] = 0;
+    current[1] = 32767;
+    integrator.Integrate(samples, current, 10.3);
+    CHECK_NEAR(integrator.GetAxis(0), 0, 1e-9);
+    CHECK_NEAR(integrator.GetAxis(1), 1, 1e-9);
+}
+
+static void testEventClock()
+{
+    // Read 4 ms faster than the first event, then 4 ms slower: that is
+    // latency, up to the drift the offset may creep meanwhile
+    EventClock clock;
+    CHECK_NEAR(clock.Map(1000, 100.005), 100.005, 1e-9);
+    CHECK_NEAR(clock.Map(1010, 100.011), 100.011, 1e-9);
+    CHECK_NEAR(clock.Map(1020, 100.025), 100.021, 1e-4);
+
+    // The millisecond counter wraps around
+    EventClock wrapping;
+    __u32 before = 0xffffffffu - 4;
+    double start = wrapping.Map(before, 50.0);
+    CHECK_NEAR(wrapping.Map(before + 10, 50.010), start + 0.010, 1e-9);
+    CHECK_NEAR(wrapping.Map(before + 1010, 51.010), start + 1.010, 1e-9);
+
+    // The event clock jumps back (the device reconnected): the offset is
+    // taken over right away instead of placing samples far in the past
+    EventClock jumping;
+    jumping.Map(500000, 200.0);
+    CHECK_NEAR(jumping.Map(20, 200.5), 200.5, 1e-9);
+    CHECK_NEAR(jumping.Map(30, 200.51), 200.51, 1e-9);
+
+    // A too small offset creeps up by drift, mapped times never lie in
+    // the future
+    EventClock drifting;
+    drifting.drift = 0.01;
+    drifting.Map(0, 10.0);
+    double t = drifting.Map(1000, 11.05);
+    CHECK_NEAR(t, 11.0105, 1e-9);
+    CHECK(t <= 11.05);
+    for (int i = 2; i <= 10; i++)
+        t = drifting.Map(1000*i, 10.05 + i);
+    CHECK_NEAR(t, 20.05, 1e-9);
+}
+
+int main()
+{
+    testFilter();
+    testIntegrate();
+    testEventClock();
+    return TEST_RESULT;
+}
@@ -0,0 +1,115 @@
+// Brick prefetcher: memory budget and LRU order of on-demand accesses,
+// the hit flag, and bricks in the predicted view loaded ahead of use
+
+#include "BrickPrefetcher.h"
+#include "TestCheck.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define BRICKS 8
+
+static bool access(BrickPrefetcher& prefetcher, int id)
+{
+    uint64_t size;
+    bool hit = false;
+    const char* data = prefetcher.Access(id, &size, &hit);
+    CHECK(data != NULL);
+    return hit;
+}
+
+// Every brick is 1.5 pages, so neighbours share a page
+static void testBudget(const char* path, uint64_t brickSize)
+{
+    BrickPrefetcher prefetcher(3*brickSize, 1);
+    for (int i = 0; i < BRICKS; i++)
+    {
+        double bounds[6] = { (double)i, i + 1.0, 0, 1, 0, 1 };
+        CHECK(prefetcher.AddBrick(path, bounds, i*brickSize, brickSize) == i);
+    }
+    double bounds[6] = { 0, 1, 0, 1, 0, 1 };
+    CHECK(prefetcher.AddBrick(path, bounds, BRICKS*brickSize, 1) == -1);
+    uint64_t size;
+    CHECK(prefetcher.Access(BRICKS, &size) == NULL);
+
+    CHECK(!access(prefetcher, 0));
+    CHECK(!access(prefetcher, 1));
+    CHECK(!access(prefetcher, 2));
+    CHECK(access(prefetcher, 0));
+
+    // 1 is the least recently used and makes room for 3
+    CHECK(!access(prefetcher, 3));
+    CHECK(access(prefetcher, 0));
+    CHECK(access(prefetcher, 2));
+    CHECK(access(prefetcher, 3));
+    CHECK(!access(prefetcher, 1));
+
+    prefetch_stats s = prefetcher.GetStats();
+    CHECK(s.hits == 4);
+    CHECK(s.misses == 5);
+    CHECK(s.evicted == 2);
+    CHECK(s.wasted == 0);
+    CHECK(s.prefetched == 0);
+    CHECK(s.residentBytes == 3*brickSize);
+}
+
+// A camera at the origin looking down +x sees the bricks along x
+static void testPrefetch(const char* path, uint64_t brickSize)
+{
+    BrickPrefetcher prefetcher(3*brickSize, 2);
+    for (int i = 0; i < BRICKS; i++)
+    {
+        double x = i < 2 ? 2.0 + i : -10.0 - i;
+        double bounds[6] = { x, x + 1, -0.5, 0.5, -0.5, 0.5 };
+        prefetcher.AddBrick(path, bounds, i*brickSize, brickSize);
+    }
+
+    prefetch_camera camera = {};
+    camera.direction[0] = 1;
+    camera.viewUp[2] = 1;
+    camera.viewAngle = 30;
+    camera.aspect = 1;
+    camera.clippingRange[0] = 0.1;
+    camera.clippingRange[1] = 100;
+    camera.horizon = 0.3;
+    camera.step = 0.1;
+    prefetcher.Update(camera);
+
+    prefetch_stats s;
+    for (int i = 0; i < 5000; i++)
+    {
+        s = prefetcher.GetStats();
+        if (s.prefetched == 2 && s.pending == 0)
+            break;
+        usleep(1000);
+    }
+    CHECK(s.prefetched == 2);
+    CHECK(s.pending == 0);
+    CHECK(access(prefetcher, 0));
+    CHECK(access(prefetcher, 1));
+    CHECK(!access(prefetcher, 5));
+}
+
+int main()
+{
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t brickSize = page + page/2;
+
+    char path[] = "/tmp/TestBrickPrefetcherXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return TEST_SKIPPED;
+    }
+    std::vector<char> data(BRICKS*brickSize, 7);
+    CHECK(write(fd, &data[0], data.size()) == (ssize_t)data.size());
+    close(fd);
+
+    testBudget(path, brickSize);
+    testPrefetch(path, brickSize);
+
+    unlink(path);
+    return TEST_RESULT;
+}
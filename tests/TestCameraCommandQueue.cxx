@@ -0,0 +1,96 @@
+// Lock-free camera command queue: tickets, the full queue, the ticket
+// limit of Pop() and several producers against one consumer
+
+#include "CameraCommandQueue.h"
+#include "TestCheck.h"
+
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+#define PRODUCERS 4
+#define COMMANDS 20000
+
+static void testSingle()
+{
+    CameraCommandQueue queue(3);
+    std::shared_ptr<std::promise<bool> > done = std::make_shared<std::promise<bool> >();
+    std::future<bool> result = done->get_future();
+
+    CHECK(queue.GetLastTicket() == 0);
+    CHECK(queue.Push(CAMERA_SET_SPEED, 1.0, done) == 1);
+    CHECK(queue.Push(CAMERA_SET_SPEED, 2.0, NULL) == 2);
+    CHECK(queue.Push(CAMERA_SET_SPEED, 3.0, NULL) == 3);
+    CHECK(queue.Push(CAMERA_SET_SPEED, 4.0, NULL) == 4);
+    // Rounded up to 4 slots, the fifth does not fit
+    CHECK(queue.Push(CAMERA_SET_SPEED, 5.0, NULL) == 0);
+    CHECK(queue.GetLastTicket() == 4);
+
+    camera_command command;
+    CHECK(!queue.Pop(&command, 0));
+    CHECK(queue.Pop(&command, 1));
+    CHECK(command.ticket == 1);
+    CHECK(command.value == 1.0);
+    CHECK(command.done == done);
+    CHECK(!queue.Pop(&command, 1));
+    command.done->set_value(true);
+    CHECK(result.get());
+
+    // Freed slots are reused
+    CHECK(queue.Push(CAMERA_TURNTABLE, 5.0, NULL) == 5);
+    for (uint64_t ticket = 2; ticket <= 5; ticket++)
+    {
+        CHECK(queue.Pop(&command, 5));
+        CHECK(command.ticket == ticket);
+        CHECK(command.value == (double)ticket);
+    }
+    CHECK(!queue.Pop(&command, 5));
+}
+
+// Every command arrives once, each producer's in the order it pushed them
+static void testProducers()
+{
+    CameraCommandQueue queue(64);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        producers.push_back(std::thread([&queue, p]() {
+            for (int i = 0; i < COMMANDS; i++)
+                while (queue.Push(p, i, NULL) == 0)
+                    sched_yield();
+        }));
+    }
+
+    std::vector<int> next(PRODUCERS, 0);
+    uint64_t lastTicket = 0;
+    int received = 0, disorder = 0;
+    camera_command command;
+    while (received < PRODUCERS*COMMANDS)
+    {
+        if (!queue.Pop(&command, queue.GetLastTicket()))
+        {
+            sched_yield();
+            continue;
+        }
+        if (command.type < 0 || command.type >= PRODUCERS || command.value != next[command.type] ||
+            command.ticket <= lastTicket)
+            disorder++;
+        else
+            next[command.type]++;
+        lastTicket = command.ticket;
+        received++;
+    }
+    for (int p = 0; p < PRODUCERS; p++)
+        producers[p].join();
+
+    CHECK(disorder == 0);
+    CHECK(!queue.Pop(&command, queue.GetLastTicket()));
+    CHECK(queue.GetLastTicket() == (uint64_t)PRODUCERS*COMMANDS);
+}
+
+int main()
+{
+    testSingle();
+    testProducers();
+    return TEST_RESULT;
+}
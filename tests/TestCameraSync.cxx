@@ -0,0 +1,147 @@
+// Leader and followers in separate processes on loopback multicast:
+// frame pacing, and followers picking up a restarted leader whose
+// sequence numbers start over. Skipped when multicast does not work here.
+
+#include "CameraSync.h"
+#include "TestCheck.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GROUP       "239.255.76.71"
+#define FOLLOWERS   2
+#define FRAMES      50
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// position[0] numbers the frames across both leaders, position[1] is the
+// leader, position[2] set means stop
+static void publish(CameraSyncLeader& leader, int frame, int session, bool last = false)
+{
+    camera_sync_packet packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.position[0] = frame;
+    packet.position[1] = session;
+    packet.position[2] = last;
+    leader.Publish(&packet);
+}
+
+// Exit code 0 when frames only moved forward and both leaders were seen
+static int follow(int port)
+{
+    CameraSyncFollower follower;
+    if (!follower.Open(GROUP, port))
+        return 3;
+
+    double deadline = now() + 20;
+    double lastFrame = 0;
+    bool secondLeader = false;
+    while (now() < deadline)
+    {
+        camera_sync_packet packet;
+        if (!follower.Receive(&packet))
+        {
+            usleep(500);
+            continue;
+        }
+        if (packet.position[0] < lastFrame)
+            return 1;
+        lastFrame = packet.position[0];
+        secondLeader |= packet.position[1] == 2;
+
+        // Frame rendered
+        follower.SendReady();
+        if (packet.position[2] != 0)
+            return secondLeader ? 0 : 1;
+    }
+    return 2;
+}
+
+int main()
+{
+    int port = 20000 + getpid() % 20000;
+
+    pid_t followers[FOLLOWERS];
+    for (int i = 0; i < FOLLOWERS; i++)
+    {
+        followers[i] = fork();
+        if (followers[i] == 0)
+            _exit(follow(port));
+    }
+
+    int frame = 0;
+    bool connected = false;
+    {
+        CameraSyncLeader leader;
+        if (leader.Open(GROUP, port))
+        {
+            // Until the followers joined the group
+            double deadline = now() + 5;
+            while (!connected && now() < deadline)
+            {
+                publish(leader, ++frame, 1);
+                connected = leader.WaitForFollowers(FOLLOWERS, 100);
+            }
+        }
+
+        if (connected)
+        {
+            // Every frame is acknowledged by every follower
+            int paced = 0;
+            for (int i = 0; i < FRAMES; i++)
+            {
+                publish(leader, ++frame, 1);
+                paced += leader.WaitForFollowers(FOLLOWERS, 1000);
+            }
+            CHECK(paced == FRAMES);
+        }
+    }
+
+    if (!connected)
+    {
+        std::cerr << "multicast on loopback not available" << std::endl;
+        for (int i = 0; i < FOLLOWERS; i++)
+        {
+            kill(followers[i], SIGTERM);
+            waitpid(followers[i], NULL, 0);
+        }
+        return TEST_SKIPPED;
+    }
+
+    // The restarted leader counts from 1 again and is still followed
+    {
+        CameraSyncLeader leader;
+        CHECK(leader.Open(GROUP, port));
+        int paced = 0;
+        for (int i = 0; i < FRAMES; i++)
+        {
+            publish(leader, ++frame, 2);
+            paced += leader.WaitForFollowers(FOLLOWERS, 1000);
+        }
+        CHECK(paced == FRAMES);
+
+        // The stop frame may get lost like any other
+        for (int i = 0; i < 10; i++)
+        {
+            publish(leader, frame, 2, true);
+            usleep(10000);
+        }
+    }
+
+    for (int i = 0; i < FOLLOWERS; i++)
+    {
+        int status;
+        CHECK(waitpid(followers[i], &status, 0) == followers[i]);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    return TEST_RESULT;
+}
@@ -0,0 +1,35 @@
+#ifndef __TESTCHECK_H__
+#define __TESTCHECK_H__
+
+// Minimal checks for the unit tests: a failed CHECK prints where and what
+// failed and makes TEST_RESULT nonzero, the test keeps running.
+
+#include <iostream>
+#include <math.h>
+
+static int testFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+    do { \
+        double checkA = (a), checkB = (b); \
+        if (!(fabs(checkA - checkB) <= (tolerance))) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #a " == " #b \
+                      << " (" << checkA << " vs " << checkB << ")" << std::endl; \
+            testFailures++; \
+        } \
+    } while (0)
+
+// Exit code that makes CTest report the test as skipped
+#define TEST_SKIPPED 77
+
+#define TEST_RESULT (testFailures == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,77 @@
+// Interruptible rendering: which gamepad changes abort a frame, and the
+// limit on aborted frames in a row that keeps the display updating
+
+#include "FrameAbort.h"
+#include "TestCheck.h"
+
+static void testGamepadChanged()
+{
+    gp_state start;
+    start.axis.assign(8, 0);
+    start.button.assign(12, 0);
+    gp_state now = start;
+    CHECK(!FrameAbort::GamepadChanged(start, now, 0.1));
+
+    // Sticks past the threshold, either way
+    now.axis[2] = 3000;
+    CHECK(!FrameAbort::GamepadChanged(start, now, 0.1));
+    now.axis[2] = -3300;
+    CHECK(FrameAbort::GamepadChanged(start, now, 0.1));
+    CHECK(!FrameAbort::GamepadChanged(start, now, 0.2));
+
+    // The d-pad axes never abort, buttons always do
+    now = start;
+    now.axis[5] = 32767;
+    CHECK(!FrameAbort::GamepadChanged(start, now, 0.1));
+    now.button[7] = 1;
+    CHECK(FrameAbort::GamepadChanged(start, now, 0.1));
+
+    // A different device
+    now = start;
+    now.axis.resize(6);
+    CHECK(FrameAbort::GamepadChanged(start, now, 0.1));
+}
+
+static void testLimit()
+{
+    FrameAbort frames;
+
+    // Once per frame
+    frames.Start();
+    CHECK(frames.MayAbort(2));
+    frames.Abort();
+    CHECK(frames.Aborted());
+    CHECK(!frames.MayAbort(2));
+
+    // Two aborted in a row, the third frame is completed
+    frames.Start();
+    CHECK(frames.MayAbort(2));
+    frames.Abort();
+    frames.Start();
+    CHECK(!frames.Aborted());
+    CHECK(!frames.MayAbort(2));
+    CHECK(frames.MayAbort(3));
+
+    // A completed frame starts the count over
+    frames.Start();
+    CHECK(frames.MayAbort(2));
+    frames.Abort();
+    frames.Start();
+    CHECK(frames.MayAbort(2));
+
+    // 0 never aborts, a new window forgets the history
+    CHECK(!frames.MayAbort(0));
+    frames.Abort();
+    frames.Start();
+    frames.Abort();
+    frames.Reset();
+    CHECK(!frames.Aborted());
+    CHECK(frames.MayAbort(1));
+}
+
+int main()
+{
+    testGamepadChanged();
+    testLimit();
+    return TEST_RESULT;
+}
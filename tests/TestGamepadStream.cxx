@@ -0,0 +1,241 @@
+// Gamepad stream over loopback UDP: sequence numbers, late packets, a
+// restarted sender, whose sequence numbers start over, forwarded axis
+// changes and copies of the state taken while packets arrive
+
+#include "GamepadStream.h"
+#include "TestCheck.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// Hand made packet setting axis 0, to control session and sequence
+static void sendPacket(int sock, int port, uint32_t session, uint32_t sequence, int16_t value)
+{
+    struct {
+        gp_stream_header header;
+        gp_stream_entry entry;
+    } packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.header.magic = htonl(GP_STREAM_MAGIC);
+    packet.header.version = htons(GP_STREAM_VERSION);
+    packet.header.type = GP_STREAM_DELTA;
+    packet.header.count = 1;
+    packet.header.sequence = htonl(sequence);
+    packet.header.session = htonl(session);
+    packet.header.eventTimeLo = htonl(sequence);
+    packet.entry.type = JS_EVENT_AXIS;
+    packet.entry.number = 0;
+    packet.entry.value = htons(value);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sendto(sock, &packet, sizeof(packet), 0, (sockaddr*)&addr, sizeof(addr));
+}
+
+// Wait for the receiving thread to apply everything that was sent
+static bool waitFor(RemoteGamepad& remote, uint64_t packets)
+{
+    double deadline = now() + 2;
+    while (remote.getStats().packets + remote.getStats().late < packets)
+    {
+        if (now() > deadline)
+            return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+static bool waitForAxis(RemoteGamepad& remote, int value)
+{
+    double deadline = now() + 2;
+    while (remote.getGamepadState()->axis[0] != value)
+    {
+        if (now() > deadline)
+            return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+static void testSequence(int port)
+{
+    RemoteGamepad remote(port);
+    CHECK(remote.IsActive());
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    // In order, with a gap of two lost packets
+    sendPacket(sock, port, 7, 1, 100);
+    sendPacket(sock, port, 7, 2, 200);
+    sendPacket(sock, port, 7, 5, 500);
+    CHECK(waitFor(remote, 3));
+    CHECK(remote.getGamepadState()->axis[0] == 500);
+
+    // Reordered: dropped
+    sendPacket(sock, port, 7, 4, 400);
+    CHECK(waitFor(remote, 4));
+    CHECK(remote.getGamepadState()->axis[0] == 500);
+
+    // The sender restarted: taken although the sequence went back
+    sendPacket(sock, port, 8, 1, -100);
+    sendPacket(sock, port, 8, 2, -200);
+    CHECK(waitFor(remote, 6));
+    CHECK(remote.getGamepadState()->axis[0] == -200);
+
+    // Sequence numbers wrap
+    sendPacket(sock, port, 9, 0xffffffff, 1);
+    sendPacket(sock, port, 9, 0, 2);
+    CHECK(waitFor(remote, 8));
+    CHECK(remote.getGamepadState()->axis[0] == 2);
+
+    gp_stream_stats stats = remote.getStats();
+    CHECK(stats.packets == 7);
+    CHECK(stats.late == 1);
+    CHECK(stats.lost == 2);
+    CHECK(stats.sessions == 3);
+    close(sock);
+}
+
+static void testRestartedSender(int port)
+{
+    RemoteGamepad remote(port);
+    gp_state state;
+    state.axis.resize(8, 0);
+    state.button.resize(12, 0);
+
+    GamepadStreamSender* sender = new GamepadStreamSender();
+    CHECK(sender->Open("127.0.0.1", port));
+    for (int i = 1; i <= 20; i++)
+    {
+        state.axis[0] = 1000 + i;
+        sender->Send(&state);
+    }
+    CHECK(waitForAxis(remote, 1020));
+    delete sender;
+
+    // Same port, new process: sequence numbers start at 1 again
+    sender = new GamepadStreamSender();
+    CHECK(sender->Open("127.0.0.1", port));
+    state.axis[0] = -5000;
+    state.button[3] = 1;
+    sender->Send(&state);
+    CHECK(waitForAxis(remote, -5000));
+    CHECK(remote.getGamepadState()->button[3] == 1);
+    delete sender;
+
+    gp_stream_stats stats = remote.getStats();
+    CHECK(stats.late == 0);
+    CHECK(stats.sessions == 2);
+
+    // Changes were timed when they were taken, on one host the clocks agree
+    CHECK(stats.latencyMax >= stats.latencyMean);
+    CHECK(stats.latencyMean >= 0 && stats.latencyMax < 1000);
+}
+
+// Axis changes arrive in order, with their spacing and on the local clock
+static void testSamples(int port)
+{
+    RemoteGamepad remote(port);
+    gp_state state;
+    state.axis.resize(8, 0);
+    state.button.resize(12, 0);
+    GamepadStreamSender sender;
+    CHECK(sender.Open("127.0.0.1", port));
+
+    double sent = now();
+    std::vector<gp_axis_sample> samples;
+    const signed short values[3] = { 4000, 12000, -8000 };
+    for (int i = 0; i < 3; i++)
+    {
+        gp_axis_sample sample = { sent - 0.030 + i*0.010, sent, (unsigned char)(i == 2 ? 1 : 0), values[i] };
+        samples.push_back(sample);
+    }
+    state.axis[0] = 12000;
+    state.axis[1] = -8000;
+    sender.SendSamples(samples);
+    sender.Send(&state);
+    CHECK(waitFor(remote, 2));
+    CHECK(waitForAxis(remote, 12000));
+    double received = now();
+
+    std::vector<gp_axis_sample> remoteSamples;
+    remote.getAxisSamples(remoteSamples);
+    CHECK(remoteSamples.size() == 3);
+    if (remoteSamples.size() == 3)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            CHECK(remoteSamples[i].value == values[i]);
+            CHECK(remoteSamples[i].time <= remoteSamples[i].delivered);
+            CHECK(remoteSamples[i].time >= sent - 0.031 && remoteSamples[i].delivered <= received);
+        }
+        CHECK(remoteSamples[2].number == 1);
+        CHECK_NEAR(remoteSamples[1].time - remoteSamples[0].time, 0.010, 1e-5);
+        CHECK_NEAR(remoteSamples[2].time - remoteSamples[1].time, 0.010, 1e-5);
+    }
+    CHECK(remote.getGamepadState()->axis[1] == -8000);
+
+    // Handed out once
+    remote.getAxisSamples(remoteSamples);
+    CHECK(remoteSamples.empty());
+}
+
+// Every packet sets the sticks to the same value, no copy may mix two
+static void testConsistentCopy(int port)
+{
+    RemoteGamepad remote(port);
+    GamepadStreamSender sender;
+    CHECK(sender.Open("127.0.0.1", port));
+
+    std::thread send([&sender]() {
+        gp_state state;
+        state.axis.resize(8, 0);
+        state.button.resize(12, 0);
+        for (int i = 1; i <= 2000; i++)
+        {
+            for (int a = 0; a < 4; a++)
+                state.axis[a] = i;
+            sender.Send(&state);
+            if (i % 50 == 0)
+                usleep(1000);
+        }
+    });
+
+    gp_state copy;
+    int mixed = 0;
+    double deadline = now() + 5;
+    do
+    {
+        remote.copyGamepadState(&copy);
+        for (int a = 1; a < 4; a++)
+            if (copy.axis[a] != copy.axis[0])
+                mixed++;
+    } while (copy.axis[0] != 2000 && now() < deadline);
+    send.join();
+
+    CHECK(mixed == 0);
+    CHECK(copy.axis[0] > 0);
+}
+
+int main()
+{
+    int port = 30000 + getpid() % 20000;
+    testSequence(port);
+    testRestartedSender(port + 1);
+    testSamples(port + 2);
+    testConsistentCopy(port + 3);
+    return TEST_RESULT;
+}
@@ -0,0 +1,235 @@
+// Loose grid culling: the incremental visible set matches testing every
+// box against the frustum while the camera moves, boxes move and boxes
+// are removed; only cells that can change are tested and the deadline
+// heaps stay bounded
+
+#include "LooseGrid.h"
+#include "TestCheck.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+struct box {
+    double bounds[6];
+    unsigned long time;
+    bool present;
+};
+
+static double random(double from, double to)
+{
+    return from + (to - from)*rand()/RAND_MAX;
+}
+
+static void cross(const double* a, const double* b, double* c)
+{
+    c[0] = a[1]*b[2] - a[2]*b[1];
+    c[1] = a[2]*b[0] - a[0]*b[2];
+    c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static void normalize(double* v)
+{
+    double length = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    for (int k = 0; k < 3; k++)
+        v[k] /= length;
+}
+
+// Perspective frustum looking along yaw and pitch, z up
+static grid_view makeView(const double* position, double yaw, double pitch, double viewAngle)
+{
+    grid_view view;
+    double up[3] = { 0, 0, 1 }, right[3];
+    double* d = view.direction;
+    d[0] = cos(yaw)*cos(pitch);
+    d[1] = sin(yaw)*cos(pitch);
+    d[2] = sin(pitch);
+    cross(d, up, right);
+    normalize(right);
+    cross(right, d, view.viewUp);
+    for (int k = 0; k < 3; k++)
+        view.position[k] = position[k];
+    view.clippingRange[0] = 0.1;
+    view.clippingRange[1] = 60;
+    view.viewAngle = viewAngle;
+    view.aspect = 1.5;
+    view.parallel = 0;
+    view.parallelScale = 1;
+    view.windowCenter[0] = view.windowCenter[1] = 0;
+
+    double a = viewAngle*M_PI/360, b = atan(tan(a)*view.aspect);
+    double normals[6][3];
+    for (int k = 0; k < 3; k++)
+    {
+        normals[0][k] = d[k]*sin(b) + right[k]*cos(b);
+        normals[1][k] = d[k]*sin(b) - right[k]*cos(b);
+        normals[2][k] = d[k]*sin(a) + view.viewUp[k]*cos(a);
+        normals[3][k] = d[k]*sin(a) - view.viewUp[k]*cos(a);
+        normals[4][k] = d[k];
+        normals[5][k] = -d[k];
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        double offset = -(normals[i][0]*position[0] + normals[i][1]*position[1] + normals[i][2]*position[2]);
+        if (i == 4)
+            offset -= view.clippingRange[0];
+        if (i == 5)
+            offset += view.clippingRange[1];
+        for (int k = 0; k < 3; k++)
+            view.planes[4*i + k] = normals[i][k];
+        view.planes[4*i + 3] = offset;
+    }
+    return view;
+}
+
+// Not entirely behind any plane
+static bool visible(const grid_view& view, const double* bounds)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        const double* p = view.planes + 4*i;
+        double farthest = p[3];
+        for (int k = 0; k < 3; k++)
+            farthest += p[k]*(p[k] > 0 ? bounds[2*k + 1] : bounds[2*k]);
+        if (farthest < 0)
+            return false;
+    }
+    return true;
+}
+
+static void place(box* b, double size)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        double center = random(-50, 50);
+        b->bounds[2*k] = center - size;
+        b->bounds[2*k + 1] = center + size;
+    }
+    b->time++;
+}
+
+// One frame over the boxes still present, false when a box's visibility
+// differs from the full test
+static bool frame(LooseGrid* grid, std::vector<box>& boxes, const grid_view& view)
+{
+    grid->BeginFrame();
+    std::vector<int> ids(boxes.size(), -1);
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        if (!boxes[i].present)
+            continue;
+        bool stale;
+        ids[i] = grid->Touch(&boxes[i], boxes[i].time, &stale);
+        if (stale)
+            grid->SetBounds(ids[i], boxes[i].bounds);
+    }
+    grid->Classify(view);
+
+    bool match = true;
+    for (size_t i = 0; i < boxes.size(); i++)
+        if (boxes[i].present && grid->IsVisible(ids[i]) != visible(view, boxes[i].bounds))
+            match = false;
+    return match;
+}
+
+static void testMatchesFullTest()
+{
+    srand(3);
+    std::vector<box> boxes(3000);
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        boxes[i].time = 0;
+        boxes[i].present = true;
+        place(&boxes[i], random(0.1, 2));
+    }
+
+    LooseGrid grid(10);
+    double position[3] = { 0, 0, 0 };
+    double yaw = 0, angle = 40;
+    int mismatches = 0;
+    for (int f = 0; f < 600; f++)
+    {
+        // Smooth turning and flying, with a jump, a zoom, moved and
+        // removed boxes now and then
+        yaw += 0.01;
+        position[0] += 0.05*cos(yaw);
+        position[1] += 0.05*sin(yaw);
+        if (f == 200)
+            position[2] = 20;
+        if (f == 300)
+            angle = 30;
+        if (f % 7 == 0)
+            place(&boxes[rand() % boxes.size()], random(0.1, 2));
+        if (f % 50 == 0)
+            boxes[rand() % boxes.size()].present = false;
+
+        grid_view view = makeView(position, yaw, 0.3*sin(f*0.02), angle);
+        if (!frame(&grid, boxes, view))
+            mismatches++;
+
+        CHECK(grid.GetDeadlineCount() <= 3*(5*grid.GetCellCount() + 64));
+    }
+    CHECK(mismatches == 0);
+}
+
+// Boxes clearly in view or clearly out of it, so no cell straddles
+static void testOnlyChangedCells()
+{
+    std::vector<box> boxes(4);
+    const double centers[4][3] = { { 20, 0, 0 }, { 30, 5, 0 }, { -30, 0, 0 }, { 0, -40, 0 } };
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            boxes[i].bounds[2*k] = centers[i][k] - 1;
+            boxes[i].bounds[2*k + 1] = centers[i][k] + 1;
+        }
+        boxes[i].time = 1;
+        boxes[i].present = true;
+    }
+
+    LooseGrid grid(4);
+    double position[3] = { 0, 0, 0 };
+    CHECK(frame(&grid, boxes, makeView(position, 0, 0, 40)));
+    CHECK(grid.GetCellsTested() == 4);
+    CHECK(grid.GetBoxesTested() == 0);
+
+    // Standing still or moving less than any cell's slack tests nothing
+    CHECK(frame(&grid, boxes, makeView(position, 0, 0, 40)));
+    CHECK(grid.GetCellsTested() == 0);
+    position[0] = 0.1;
+    CHECK(frame(&grid, boxes, makeView(position, 0, 0, 40)));
+    CHECK(grid.GetCellsTested() == 0);
+
+    // A moved box only tests the cells it left and entered
+    boxes[0].bounds[2] += 3;
+    boxes[0].bounds[3] += 3;
+    boxes[0].time++;
+    CHECK(frame(&grid, boxes, makeView(position, 0, 0, 40)));
+    CHECK(grid.GetCellsTested() >= 1 && grid.GetCellsTested() <= 2);
+
+    // Turning around reaches the deadlines of the cells ahead and behind
+    CHECK(frame(&grid, boxes, makeView(position, M_PI, 0, 40)));
+    CHECK(grid.GetCellsTested() > 0);
+
+    // A new view angle changes the frustum's shape, everything is tested
+    CHECK(frame(&grid, boxes, makeView(position, M_PI, 0, 50)));
+    CHECK(grid.GetCellsTested() == 4);
+
+    // Removed boxes are forgotten, back again they are new
+    boxes[3].present = false;
+    CHECK(frame(&grid, boxes, makeView(position, M_PI, 0, 50)));
+    grid.BeginFrame();
+    bool stale;
+    grid.Touch(&boxes[3], boxes[3].time, &stale);
+    CHECK(stale);
+    grid.Touch(&boxes[0], boxes[0].time, &stale);
+    CHECK(!stale);
+}
+
+int main()
+{
+    testMatchesFullTest();
+    testOnlyChangedCells();
+    return TEST_RESULT;
+}
@@ -0,0 +1,262 @@
+// Camera navigation: the same input through the sample path of
+// SimulateNavigation() and through the key events and per-tick gamepad
+// integration of OnTimer() gives the same camera poses
+
+#include "NavigationIntegrator.h"
+#include "AxisIntegrator.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// A wall at z = 3 the camera keeps 0.5 away from, and half speed for
+// x > 1
+class WallScene : public NavigationScene {
+public:
+    WallScene() : blocked(0) {}
+
+    double Collide(const double* from, double* motion)
+    {
+        double requested = sqrt(motion[0]*motion[0] + motion[1]*motion[1] + motion[2]*motion[2]);
+        if (from[2] + motion[2] >= 3.5)
+            return 1.0;
+        motion[2] = std::min(0.0, 3.5 - from[2]);
+        this->blocked++;
+        double left = sqrt(motion[0]*motion[0] + motion[1]*motion[1] + motion[2]*motion[2]);
+        return requested > 0 ? left/requested : 1.0;
+    }
+
+    double SpeedScale(const double* position) { return position[0] > 1 ? 0.5 : 1.0; }
+
+    int blocked;
+};
+
+static const int SAMPLES = 430;
+static const double DT = 0.02;
+
+static void setRange(double* input, int from, int to, int column, double value)
+{
+    for (int i = from; i < to; i++)
+        input[i*NAV_SAMPLE_SIZE + column] = value;
+}
+
+static void orRange(double* input, int from, int to, int column, int bits)
+{
+    for (int i = from; i < to; i++)
+        input[i*NAV_SAMPLE_SIZE + column] = (int)input[i*NAV_SAMPLE_SIZE + column] | bits;
+}
+
+static void makeInput(double* input)
+{
+    memset(input, 0, SAMPLES*NAV_SAMPLE_SIZE*sizeof(double));
+    for (int i = 0; i < SAMPLES; i++)
+        input[i*NAV_SAMPLE_SIZE + NAV_TIME] = i*DT;
+
+    // 0-109 only the pick flight started before
+    orRange(input, 110, 160, NAV_KEYS, NAV_KEY_W);
+    setRange(input, 110, 160, NAV_AXIS0, 16000);
+    orRange(input, 160, 162, NAV_KEYS, NAV_KEY_BRACKETRIGHT);
+    orRange(input, 164, 166, NAV_KEYS, NAV_KEY_BRACKETRIGHT);
+    orRange(input, 170, 210, NAV_KEYS, NAV_KEY_D);
+    setRange(input, 180, 230, NAV_AXIS2, -20000);
+    setRange(input, 180, 230, NAV_AXIS3, 12000);
+    orRange(input, 190, 200, NAV_KEYS, NAV_KEY_Q);
+    // Into the wall
+    orRange(input, 230, 290, NAV_KEYS, NAV_KEY_W);
+    // Bookmark 1 behind the wall
+    orRange(input, 290, 293, NAV_BUTTONS, 1 << 0);
+    // Turntable mode ignores the d-pad and keeps the look speed
+    orRange(input, 310, 313, NAV_BUTTONS, 1 << 8);
+    setRange(input, 320, 350, NAV_AXIS0, 20000);
+    setRange(input, 320, 350, NAV_AXIS4, 1);
+    setRange(input, 320, 350, NAV_AXIS5, 32767);
+    orRange(input, 350, 353, NAV_BUTTONS, 1 << 8);
+    setRange(input, 360, 390, NAV_AXIS4, 1);
+    setRange(input, 360, 390, NAV_AXIS5, -32767);
+    orRange(input, 390, 392, NAV_KEYS, NAV_KEY_BRACKETLEFT);
+    orRange(input, 400, 430, NAV_KEYS, NAV_KEY_S);
+}
+
+static void setup(NavigationIntegrator* integrator)
+{
+    integrator->flyDestination[0] = 1;
+    integrator->flyDestination[1] = 0.5;
+    integrator->flyDestination[2] = 4.5;
+    integrator->flyFocus[0] = 1;
+    integrator->flyFocus[1] = 0.5;
+    integrator->flyFocus[2] = 3;
+    integrator->StartFlight(5);
+}
+
+static bool samePose(const nav_pose& a, const nav_pose& b)
+{
+    for (int i = 0; i < 3; i++)
+        if (fabs(a.position[i] - b.position[i]) > 1e-9 || fabs(a.focalPoint[i] - b.focalPoint[i]) > 1e-9 ||
+            fabs(a.viewUp[i] - b.viewUp[i]) > 1e-9)
+            return false;
+    return true;
+}
+
+static void testPathsMatch()
+{
+    static double input[SAMPLES*NAV_SAMPLE_SIZE];
+    makeInput(input);
+    const nav_pose start = { {0, 0, 5}, {0, 0, 4}, {0, 1, 0} };
+    const double deadzone = 0.1, exponent = 2;
+
+    // SimulateNavigation(): sample i-1 held until the time of sample i
+    NavigationIntegrator simulated;
+    simulated.deadzone = deadzone;
+    simulated.responseExponent = exponent;
+    setup(&simulated);
+    WallScene simulatedScene;
+    nav_pose simulatedPose = start;
+
+    // OnTimer(): key events since the previous tick, then the integrated
+    // sticks and the gamepad state at the tick
+    NavigationIntegrator timer;
+    setup(&timer);
+    WallScene timerScene;
+    nav_pose timerPose = start;
+    AxisIntegrator axes;
+    axes.deadzone = deadzone;
+    axes.exponent = exponent;
+    std::vector<signed short> current(7, 0);
+    std::vector<gp_axis_sample> axisSamples;
+    axes.Integrate(axisSamples, current, 0.0);
+    int keys = 0;
+
+    int simulatedEvents = 0, timerEvents = 0, arrived = 0, stopped = 0;
+    int mismatch = -1;
+    for (int i = 1; i < SAMPLES; i++)
+    {
+        const double* previous = input + (i - 1)*NAV_SAMPLE_SIZE;
+        double now = input[i*NAV_SAMPLE_SIZE + NAV_TIME];
+
+        simulatedEvents |= simulated.ApplySample(previous);
+        int events = simulated.Step(&simulatedPose, now - previous[NAV_TIME], &simulatedScene);
+        simulatedEvents |= events;
+        arrived += (events & NAV_FLY_ARRIVED) != 0;
+        stopped += (events & NAV_FLY_STOPPED) != 0;
+
+        int held = (int)previous[NAV_KEYS];
+        for (int key = NAV_KEY_W; key <= NAV_KEY_BRACKETRIGHT; key <<= 1)
+            if ((keys & key) && !(held & key))
+                timerEvents |= timer.HandleKey(key, false);
+        for (int key = NAV_KEY_W; key <= NAV_KEY_BRACKETRIGHT; key <<= 1)
+            if (!(keys & key) && (held & key))
+                timerEvents |= timer.HandleKey(key, true);
+        keys = held;
+
+        axisSamples.clear();
+        for (int a = 0; a < 7; a++)
+        {
+            signed short value = (signed short)previous[NAV_AXIS0 + a];
+            if (value != current[a])
+            {
+                gp_axis_sample sample;
+                sample.time = sample.delivered = previous[NAV_TIME];
+                sample.number = a;
+                sample.value = value;
+                axisSamples.push_back(sample);
+                current[a] = value;
+            }
+        }
+        axes.Integrate(axisSamples, current, now);
+        double sticks[4], dpad[3];
+        for (int a = 0; a < 4; a++)
+            sticks[a] = axes.GetAxis(a);
+        for (int a = 0; a < 3; a++)
+            dpad[a] = current[4 + a];
+        timerEvents |= timer.HandleGamepad(sticks, dpad, (int)previous[NAV_BUTTONS]);
+        timerEvents |= timer.Step(&timerPose, now - previous[NAV_TIME], &timerScene);
+
+        if (mismatch < 0 && !samePose(simulatedPose, timerPose))
+            mismatch = i;
+        CHECK(simulatedPose.position[2] >= 3.5 - 1e-9);
+    }
+
+    CHECK(mismatch == -1);
+    CHECK(simulatedEvents == timerEvents);
+    CHECK(simulatedScene.blocked == timerScene.blocked);
+    CHECK(timer.maxSpeed == simulated.maxSpeed);
+
+    // The pick flight arrived, the bookmark flight ran into the wall
+    CHECK(arrived == 1);
+    CHECK(stopped == 1);
+    CHECK(simulatedScene.blocked > 0);
+    CHECK(!simulated.flying);
+    CHECK(simulatedEvents & NAV_MODE_CHANGED);
+    CHECK(simulatedEvents & NAV_SPEED_CHANGED);
+    CHECK_NEAR(simulated.maxSpeed, 2, 1e-12);
+}
+
+static void testStep()
+{
+    WallScene scene;
+
+    // Keys at the scene's speed scale, the last key pressed wins
+    NavigationIntegrator integrator;
+    nav_pose pose = { {2, 0, 10}, {2, 0, 9}, {0, 1, 0} };
+    integrator.HandleKey(NAV_KEY_W, true);
+    CHECK(integrator.HandleKey(NAV_KEY_S, true) == NAV_KEYS_CHANGED);
+    CHECK(integrator.HandleKey(NAV_KEY_S, true) == 0);
+    integrator.Step(&pose, 1.0, &scene);
+    CHECK_NEAR(pose.position[2], 10.5, 1e-12);
+    CHECK_NEAR(pose.focalPoint[2], 9.5, 1e-12);
+    CHECK_NEAR(integrator.speedScale, 0.5, 1e-12);
+
+    // Every press of a speed key steps, within [0, 200]
+    CHECK(integrator.HandleKey(NAV_KEY_BRACKETRIGHT, true) == NAV_SPEED_CHANGED);
+    CHECK(integrator.HandleKey(NAV_KEY_BRACKETRIGHT, true) == NAV_SPEED_CHANGED);
+    CHECK_NEAR(integrator.maxSpeed, 3, 1e-12);
+    for (int i = 0; i < 5; i++)
+        integrator.HandleKey(NAV_KEY_BRACKETLEFT, true);
+    CHECK_NEAR(integrator.maxSpeed, 0, 1e-12);
+
+    // Velocity follows the speeds and the scale of the last step
+    NavigationIntegrator moving;
+    nav_pose still = { {0, 0, 10}, {0, 0, 9}, {0, 1, 0} };
+    moving.HandleKey(NAV_KEY_D, true);
+    double velocity[3];
+    moving.GetVelocity(&still, velocity);
+    CHECK_NEAR(velocity[0], 1, 1e-12);
+    CHECK_NEAR(velocity[2], 0, 1e-12);
+
+    // Mouse-look only turns with the right stick, and only for one step
+    NavigationIntegrator look;
+    nav_pose turned = still;
+    look.mouseYaw = 90;
+    look.Step(&turned, 0.1, NULL);
+    CHECK(samePose(turned, still));
+    CHECK(look.mouseYaw == 0);
+    double sticks[4] = { 0, 0, -0.5, 0 }, dpad[3] = { 0, 0, 0 };
+    look.HandleGamepad(sticks, dpad, 0);
+    look.mouseYaw = 90 - 0.5*look.gamepadLookSpeed;
+    look.Step(&turned, 1.0, NULL);
+    CHECK_NEAR(turned.focalPoint[0], -1, 1e-9);
+    CHECK_NEAR(turned.focalPoint[2], 10, 1e-9);
+
+    // A bookmark flight arrives at the bookmark
+    NavigationIntegrator flight;
+    nav_pose flying = { {0, 1, 0.5}, {0, 0, 0.5}, {0, 0, 1} };
+    double destination[3], viewDir[3];
+    CHECK(NavigationIntegrator::GetBookmark(2, destination, viewDir));
+    CHECK(!NavigationIntegrator::GetBookmark(5, destination, viewDir));
+    CHECK(flight.StartFlight(2) == NAV_FLY_STARTED);
+    CHECK(flight.StartFlight(3) == (NAV_FLY_STARTED | NAV_FLY_STOPPED));
+    flight.StartFlight(2);
+    int events = 0;
+    for (int i = 0; i < 200 && flight.flying; i++)
+        events |= flight.Step(&flying, 0.05, NULL);
+    CHECK(events == NAV_FLY_ARRIVED);
+    CHECK(fabs(flying.position[2]) <= 0.1);
+}
+
+int main()
+{
+    testPathsMatch();
+    testStep();
+    return TEST_RESULT;
+}
@@ -0,0 +1,103 @@
+// Pointer capture backends that work without a window system
+
+#include "PointerCapture.h"
+#include "TestCheck.h"
+
+#include <thread>
+
+// Window source without a window, counts its destruction
+class EmptyWindowSource : public X11WindowSource {
+public:
+    EmptyWindowSource(int* deleted) : deleted(deleted) {}
+    ~EmptyWindowSource() { (*this->deleted)++; }
+    void* GetDisplay() { return NULL; }
+    unsigned long GetWindow() { return 0; }
+
+private:
+    int* deleted;
+};
+
+static void testOffscreen()
+{
+    OffscreenPointerCapture capture;
+    const int size[2] = {640, 480};
+    double delta[2] = {0, 0};
+
+    // The first event only sets the reference position
+    int pos[2] = {100, 100};
+    CHECK(capture.Motion(pos, size, delta));
+    CHECK(delta[0] == 0 && delta[1] == 0);
+
+    pos[0] = 110; pos[1] = 95;
+    CHECK(capture.Motion(pos, size, delta));
+    pos[0] = 111; pos[1] = 97;
+    CHECK(capture.Motion(pos, size, delta));
+    CHECK_NEAR(delta[0], 11, 0);
+    CHECK_NEAR(delta[1], -3, 0);
+
+    // Nothing to poll or recenter offscreen
+    capture.Recenter(size);
+    capture.Poll(delta);
+    CHECK_NEAR(delta[0], 11, 0);
+    CHECK(!capture.InputPending());
+}
+
+static void testInjected()
+{
+    InjectedPointerCapture capture;
+    const int size[2] = {640, 480};
+    double delta[2] = {0, 0};
+
+    // Real pointer events do not count
+    int pos[2] = {300, 20};
+    CHECK(capture.Motion(pos, size, delta));
+    CHECK(!capture.InputPending());
+    capture.Poll(delta);
+    CHECK(delta[0] == 0 && delta[1] == 0);
+
+    capture.Inject(2, 3);
+    CHECK(capture.InputPending());
+    capture.Poll(delta);
+    CHECK(delta[0] == 2 && delta[1] == 3);
+
+    // Motion injected from other threads adds up, nothing is lost
+    const int threads = 4, steps = 1000;
+    std::thread injectors[threads];
+    for (int i = 0; i < threads; i++)
+        injectors[i] = std::thread([&capture]() {
+            for (int j = 0; j < steps; j++)
+                capture.Inject(1, -0.5);
+        });
+
+    double total[2] = {0, 0};
+    for (int i = 0; i < threads; i++)
+    {
+        capture.Poll(total);
+        injectors[i].join();
+    }
+    capture.Poll(total);
+    CHECK_NEAR(total[0], threads*steps, 1e-9);
+    CHECK_NEAR(total[1], -0.5*threads*steps, 1e-9);
+
+    // Poll consumes
+    CHECK(!capture.InputPending());
+    capture.Poll(delta);
+    CHECK(delta[0] == 2 && delta[1] == 3);
+}
+
+static void testNoWindow()
+{
+    // Without a window (or without X11 support) there is no backend yet,
+    // and the source is not leaked
+    int deleted = 0;
+    CHECK(PointerCapture::CreateX11(new EmptyWindowSource(&deleted)) == NULL);
+    CHECK(deleted == 1);
+}
+
+int main()
+{
+    testOffscreen();
+    testInjected();
+    testNoWindow();
+    return TEST_RESULT;
+}
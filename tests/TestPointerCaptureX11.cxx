@@ -0,0 +1,173 @@
+// X11 pointer capture against a private Xvfb server: the pointer is only
+// held while the window has the focus. Skipped when Xvfb is not installed.
+
+#include "PointerCapture.h"
+#include "TestCheck.h"
+
+#include <X11/Xlib.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+class TestWindowSource : public X11WindowSource {
+public:
+    TestWindowSource(Display* display, Window window) : display(display), window(window) {}
+    void* GetDisplay() { return this->display; }
+    unsigned long GetWindow() { return this->window; }
+
+    Display* display;
+    Window window;
+};
+
+// Starts Xvfb on a free display and connects to it, NULL when it can not
+// be started. -displayfd makes the server pick the display number.
+static Display* startServer(pid_t& server)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return NULL;
+
+    server = fork();
+    if (server == 0)
+    {
+        close(fds[0]);
+        char fd[16];
+        snprintf(fd, sizeof(fd), "%d", fds[1]);
+        execlp("Xvfb", "Xvfb", "-displayfd", fd, "-nolisten", "tcp", "-screen", "0", "640x480x24", (char*)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    char number[16] = {0};
+    ssize_t n = server > 0 ? read(fds[0], number, sizeof(number) - 1) : -1;
+    close(fds[0]);
+    if (n <= 0)
+        return NULL;
+
+    char name[32];
+    snprintf(name, sizeof(name), ":%d", atoi(number));
+    return XOpenDisplay(name);
+}
+
+static Window createWindow(Display* display)
+{
+    Window window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, 320, 240, 0, 0, 0);
+    XMapWindow(display, window);
+    XSync(display, False);
+    return window;
+}
+
+static void focus(Display* display, Window window)
+{
+    XSetInputFocus(display, window, RevertToNone, CurrentTime);
+    XSync(display, False);
+}
+
+// Another client can only take the pointer while the capture has let go
+static bool pointerFree(Display* other, Window window)
+{
+    bool free = XGrabPointer(other, window, False, 0, GrabModeAsync, GrabModeAsync,
+                             None, None, CurrentTime) == GrabSuccess;
+    XUngrabPointer(other, CurrentTime);
+    XSync(other, False);
+    return free;
+}
+
+static void pointerPosition(Display* display, int* pos)
+{
+    Window root, child;
+    int x, y;
+    unsigned int mask;
+    XQueryPointer(display, DefaultRootWindow(display), &root, &child, &pos[0], &pos[1], &x, &y, &mask);
+}
+
+int main()
+{
+    pid_t server = -1;
+    Display* display = startServer(server);
+    if (display == NULL)
+    {
+        std::cerr << "Xvfb not available" << std::endl;
+        if (server > 0)
+        {
+            kill(server, SIGTERM);
+            waitpid(server, NULL, 0);
+        }
+        return TEST_SKIPPED;
+    }
+    Display* other = XOpenDisplay(DisplayString(display));
+
+    Window window = createWindow(display);
+    Window elsewhere = createWindow(display);
+    focus(display, window);
+
+    PointerCapture* capture = PointerCapture::CreateX11(new TestWindowSource(display, window));
+    CHECK(capture != NULL);
+
+    const int size[2] = {320, 240};
+    double delta[2] = {0, 0};
+    int before[2], after[2];
+
+    // Focused: the pointer is captured (grabbed with XInput 2, warped to
+    // the window center otherwise)
+    capture->Poll(delta);
+    capture->Recenter(size);
+    XSync(display, False);
+    pointerPosition(other, after);
+#ifdef GAMEPAD_USE_XINPUT2
+    CHECK(!pointerFree(other, window));
+#else
+    CHECK(after[0] == 160 && after[1] == 120);
+#endif
+
+    // Focus moves to another window: the pointer is let go and stays where
+    // the user puts it
+    focus(display, elsewhere);
+    capture->Poll(delta);
+    capture->Recenter(size);
+    XSync(display, False);
+    CHECK(pointerFree(other, window));
+    XWarpPointer(other, None, DefaultRootWindow(other), 0, 0, 0, 0, 500, 400);
+    XSync(other, False);
+    pointerPosition(other, before);
+    capture->Poll(delta);
+    capture->Recenter(size);
+    XSync(display, False);
+    pointerPosition(other, after);
+    CHECK(before[0] == after[0] && before[1] == after[1]);
+    CHECK(pointerFree(other, window));
+
+    // Focus comes back: captured again
+    focus(display, window);
+    capture->Poll(delta);
+    capture->Recenter(size);
+    XSync(display, False);
+#ifdef GAMEPAD_USE_XINPUT2
+    CHECK(!pointerFree(other, window));
+
+    // Unmapping drops the grab on the server side, it is taken again
+    // once the window is back
+    XUnmapWindow(display, window);
+    XSync(display, False);
+    capture->Poll(delta);
+    XMapWindow(display, window);
+    XSync(display, False);
+    focus(display, window);
+    capture->Poll(delta);
+    capture->Recenter(size);
+    XSync(display, False);
+    CHECK(!pointerFree(other, window));
+#else
+    pointerPosition(other, after);
+    CHECK(after[0] == 160 && after[1] == 120);
+#endif
+
+    delete capture;
+    XCloseDisplay(other);
+    XCloseDisplay(display);
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    return TEST_RESULT;
+}
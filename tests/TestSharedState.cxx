@@ -0,0 +1,131 @@
+// Seqlock of the shared state export: a reader in another process never
+// gets a torn snapshot while the writer keeps publishing
+
+#include "SharedState.h"
+#include "TestCheck.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAMES 200000
+
+static double now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// Every field follows from the frame number
+static void fill(shared_state* state, uint64_t frame)
+{
+    memset(state, 0, sizeof(*state));
+    state->frame = frame;
+    state->time = frame;
+    state->frameTime = frame;
+    for (int i = 0; i < 3; i++)
+        state->position[i] = state->focalPoint[i] = state->viewUp[i] = frame;
+    state->flyto = (int32_t)frame;
+    state->axes = SHARED_STATE_AXES;
+    for (int i = 0; i < SHARED_STATE_AXES; i++)
+        state->axis[i] = (int16_t)frame;
+    for (int i = 0; i < SHARED_STATE_BUTTONS; i++)
+        state->button[i] = (int16_t)frame;
+}
+
+static bool consistent(const shared_state* state)
+{
+    shared_state expected;
+    fill(&expected, state->frame);
+    return memcmp(&expected, state, sizeof(expected)) == 0;
+}
+
+// Exit code 0 when all reads were consistent and in order
+static int readUntil(const char* name, uint64_t last)
+{
+    SharedStateReader reader;
+    double deadline = now() + 20;
+    while (!reader.Open(name))
+    {
+        if (now() > deadline)
+            return 2;
+        usleep(1000);
+    }
+
+    uint64_t reads = 0, frame = 0;
+    while (frame < last && now() < deadline)
+    {
+        shared_state state;
+        if (!reader.Read(&state))
+        {
+            sched_yield();
+            continue;
+        }
+        if (!consistent(&state) || state.frame < frame)
+            return 1;
+        frame = state.frame;
+        reads++;
+    }
+    return frame == last && reads > 0 ? 0 : 3;
+}
+
+int main()
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/vtkgame-test-%d", (int)getpid());
+
+    // Nothing to read before the writer exists
+    SharedStateReader early;
+    CHECK(!early.Open(name));
+
+    SharedStateWriter writer;
+    if (!writer.Open(name))
+        return TEST_SKIPPED;
+
+    shared_state state;
+    fill(&state, 0);
+    writer.Publish(&state);
+
+    pid_t child = fork();
+    if (child == 0)
+        _exit(readUntil(name, FRAMES));
+
+    for (uint64_t frame = 1; frame <= FRAMES; frame++)
+    {
+        fill(&state, frame);
+        writer.Publish(&state);
+        if (frame % 64 == 0)
+            sched_yield();
+    }
+
+    // Until the reader saw the last frame
+    int status = 0;
+    double deadline = now() + 20;
+    pid_t done = 0;
+    while ((done = waitpid(child, &status, WNOHANG)) == 0 && now() < deadline)
+    {
+        writer.Publish(&state);
+        usleep(100);
+    }
+    if (done == 0)
+    {
+        kill(child, SIGKILL);
+        waitpid(child, &status, 0);
+    }
+    CHECK(done == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // Same process reader sees the last frame
+    SharedStateReader reader;
+    CHECK(reader.Open(name));
+    shared_state copy;
+    CHECK(reader.Read(&copy));
+    CHECK(copy.frame == FRAMES && consistent(&copy));
+
+    return TEST_RESULT;
+}
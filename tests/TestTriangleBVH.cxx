@@ -0,0 +1,159 @@
+// Triangle BVH queries: hits and misses against a brute force search, and
+// the unknown result / lower bound when the node budget runs out
+
+#include "TriangleBVH.h"
+#include "TestCheck.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+static double random(double lo, double hi)
+{
+    return lo + (hi - lo)*rand()/RAND_MAX;
+}
+
+static void addTriangle(std::vector<float>& triangles, const double* a, const double* b, const double* c)
+{
+    const double* v[3] = { a, b, c };
+    for (int i = 0; i < 3; i++)
+        for (int k = 0; k < 3; k++)
+            triangles.push_back((float)v[i][k]);
+}
+
+// Plain Moller-Trumbore, for the reference answers
+static bool bruteRaycast(const std::vector<float>& triangles, const double* origin, const double* dir, double maxT, double* t)
+{
+    bool hit = false;
+    double best = maxT;
+    for (size_t i = 0; i < triangles.size(); i += 9)
+    {
+        const float* p = &triangles[i];
+        double e1[3], e2[3], s[3], q[3], h[3];
+        for (int k = 0; k < 3; k++)
+        {
+            e1[k] = p[3+k] - p[k];
+            e2[k] = p[6+k] - p[k];
+            s[k] = origin[k] - p[k];
+        }
+        h[0] = dir[1]*e2[2] - dir[2]*e2[1];
+        h[1] = dir[2]*e2[0] - dir[0]*e2[2];
+        h[2] = dir[0]*e2[1] - dir[1]*e2[0];
+        double a = e1[0]*h[0] + e1[1]*h[1] + e1[2]*h[2];
+        if (fabs(a) < 1e-12)
+            continue;
+        double u = (s[0]*h[0] + s[1]*h[1] + s[2]*h[2])/a;
+        q[0] = s[1]*e1[2] - s[2]*e1[1];
+        q[1] = s[2]*e1[0] - s[0]*e1[2];
+        q[2] = s[0]*e1[1] - s[1]*e1[0];
+        double v = (dir[0]*q[0] + dir[1]*q[1] + dir[2]*q[2])/a;
+        double ti = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2])/a;
+        if (u < 0 || v < 0 || u + v > 1 || ti < 0 || ti > best)
+            continue;
+        best = ti;
+        hit = true;
+    }
+    *t = best;
+    return hit;
+}
+
+// A unit quad in the z = 0 plane
+static void testQuad()
+{
+    std::vector<float> triangles;
+    double a[3] = { 0, 0, 0 }, b[3] = { 1, 0, 0 }, c[3] = { 1, 1, 0 }, d[3] = { 0, 1, 0 };
+    addTriangle(triangles, a, b, c);
+    addTriangle(triangles, a, c, d);
+
+    TriangleBVH bvh;
+    bvh.Build(triangles);
+    CHECK(bvh.GetNumberOfTriangles() == 2);
+
+    double origin[3] = { 0.25, 0.5, 2 }, down[3] = { 0, 0, -1 };
+    double t, normal[3];
+    int budget = 100;
+    CHECK(bvh.Raycast(origin, down, 10, &t, normal, &budget) == BVH_HIT);
+    CHECK_NEAR(t, 2, 1e-6);
+    CHECK_NEAR(fabs(normal[2]), 1, 1e-6);
+
+    // Too short, or beside the quad
+    budget = 100;
+    CHECK(bvh.Raycast(origin, down, 1.5, &t, normal, &budget) == BVH_MISS);
+    double beside[3] = { 1.5, 0.5, 2 };
+    budget = 100;
+    CHECK(bvh.Raycast(beside, down, 10, &t, normal, &budget) == BVH_MISS);
+
+    budget = 100;
+    CHECK_NEAR(bvh.Distance(origin, 10, &budget), 2, 1e-6);
+    budget = 100;
+    CHECK_NEAR(bvh.Distance(beside, 10, &budget), sqrt(0.25 + 4), 1e-6);
+    budget = 100;
+    CHECK_NEAR(bvh.Distance(origin, 1, &budget), 1, 1e-12);
+}
+
+// Random triangles against brute force, then the same with a tiny budget
+static void testRandom()
+{
+    std::vector<float> triangles;
+    for (int i = 0; i < 5000; i++)
+    {
+        double a[3], b[3], c[3];
+        for (int k = 0; k < 3; k++)
+        {
+            a[k] = random(-10, 10);
+            b[k] = a[k] + random(-0.5, 0.5);
+            c[k] = a[k] + random(-0.5, 0.5);
+        }
+        addTriangle(triangles, a, b, c);
+    }
+    std::vector<float> reference = triangles;
+
+    TriangleBVH bvh;
+    bvh.Build(triangles);
+    CHECK(bvh.GetNumberOfTriangles() == 5000);
+
+    int hits = 0, mismatches = 0, unknown = 0;
+    for (int i = 0; i < 500; i++)
+    {
+        double origin[3], dir[3];
+        for (int k = 0; k < 3; k++)
+        {
+            origin[k] = random(-12, 12);
+            dir[k] = random(-1, 1);
+        }
+
+        double expected, t, normal[3];
+        bool hit = bruteRaycast(reference, origin, dir, 20, &expected);
+        int budget = 1000000;
+        bvh_raycast result = bvh.Raycast(origin, dir, 20, &t, normal, &budget);
+        if (result != (hit ? BVH_HIT : BVH_MISS) || (hit && fabs(t - expected) > 1e-4))
+            mismatches++;
+        hits += hit;
+
+        // A single node only answers for rays that miss the whole mesh
+        budget = 1;
+        bvh_raycast limited = bvh.Raycast(origin, dir, 20, &t, normal, &budget);
+        if (limited == BVH_UNKNOWN)
+            unknown++;
+        else if (limited != BVH_MISS || hit)
+            mismatches++;
+
+        budget = 1000000;
+        double exact = bvh.Distance(origin, 100, &budget);
+        budget = 3;
+        double bound = bvh.Distance(origin, 100, &budget);
+        if (bound > exact + 1e-9)
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(hits > 50);
+    CHECK(unknown >= hits);
+}
+
+int main()
+{
+    srand(1);
+    testQuad();
+    testRandom();
+    return TEST_RESULT;
+}